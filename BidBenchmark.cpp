@@ -0,0 +1,592 @@
+//============================================================================
+// Name        : BidBenchmark.cpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Wall-clock benchmark of the vector, hash table and tree labs
+//============================================================================
+
+// The three lab programs are compiled into this one binary, each inside its
+// own namespace with its main() renamed, and driven on generated bids.
+// Every header they include is included here first, so their own #include
+// lines are no-ops inside the namespaces.
+//
+// Usage: BidBenchmark [maxRows] [repetitions]
+// Runs 1e3, 1e4, ... rows up to maxRows (default 1e6; 1e8 needs tens of
+// gigabytes) and prints one JSON document with throughput and latency per
+// operation. Operations are timed in batches, never one by one, so the
+// latencies are p50 / p99 of batch means, each over batch_ops operations;
+// a tail shorter than a batch is averaged away. Progress goes to stderr.
+//
+//        BidBenchmark --generate-trace file keys operations skew order [printEvery]
+// Writes a synthetic trace (see BidTrace.hpp); order is shuffled, sorted
+// or reverse, and skew is the Zipf exponent (0 for uniform keys).
+//
+//        BidBenchmark --replay-trace file [repetitions]
+// Replays a recorded or generated trace against every index.
+//
+// The labs' hot-path stats counters are compiled out here, so the timed
+// operations do no bookkeeping; BidStats.cpp is not linked in either.
+
+#define BID_STATS 0
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "BidExport.hpp"
+#include "BidIndex.hpp"
+#include "BidSnapshot.hpp"
+#include "BidStats.hpp"
+#include "BidStore.hpp"
+#include "BidTrace.hpp"
+#include "MappedCsv.hpp"
+#include "NodePool.hpp"
+
+#define main hashTableMain
+namespace hashing {
+#include "HashTable (1) (2).cpp"
+}
+#undef main
+
+#define main binarySearchTreeMain
+namespace trees {
+#include "BinarySearchTree (1).cpp"
+}
+#undef main
+
+#define main vectorSortingMain
+namespace sorting {
+#include "VectorSorting (1).cpp"
+}
+#undef main
+
+using namespace std;
+
+// Point operations are timed in batches of this many, so the clock reads
+// cost little next to the work being measured
+const size_t BATCH_OPS = 64;
+// Keys handed to each SearchBatch call, the size callers look up at once
+const size_t SEARCH_BATCH_KEYS = 1024;
+// Searches and removes per repetition, capped so 1e8 rows stays practical
+const size_t MAX_QUERIES = 100000;
+// Selection sort is quadratic, so it only runs up to this size
+const size_t MAX_SELECTION_SORT_ROWS = 10000;
+
+//============================================================================
+// Generated data
+//============================================================================
+
+// Bids with ids 1000000000 + 2i in shuffled order, so every odd offset is
+// a guaranteed miss and an unbalanced tree does not degenerate on load
+struct Dataset {
+    BidStore store;
+    vector<RowId> rows;
+    vector<string> hitKeys;
+    vector<string> missKeys;
+    vector<string> removeKeys;
+    string csvPath; // the same bids in the labs' CSV layout
+};
+
+void generateBids(Dataset& data, size_t count, uint64_t seed) {
+    static const char* words[] = { "Office", "Chair", "Desk", "Lamp", "Laptop", "Monitor", "Truck", "Sedan",
+                                   "Mower", "Radio", "Printer", "Cabinet", "Table", "Camera", "Drill", "Bicycle" };
+    static const char* funds[] = { "General Fund", "Enterprise", "Special Revenue", "Capital Projects" };
+
+    mt19937_64 rng(seed);
+    vector<uint64_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    shuffle(order.begin(), order.end(), rng);
+
+    data.store.Clear();
+    data.rows.clear();
+    data.rows.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        string bidId = to_string(1000000000ULL + order[i] * 2);
+        string title = string(words[rng() % 16]) + " " + words[rng() % 16] + " " + to_string(rng() % 1000);
+        double amount = (double)(rng() % 1000000) / 100.0;
+        data.rows.push_back(data.store.Append(bidId, title, funds[rng() % 4], amount));
+    }
+
+    size_t queries = min(count, MAX_QUERIES);
+    data.hitKeys.clear();
+    data.missKeys.clear();
+    data.removeKeys.clear();
+    for (size_t i = 0; i < queries; i++) {
+        uint64_t hit = rng() % count;
+        data.hitKeys.push_back(to_string(1000000000ULL + hit * 2));
+        data.missKeys.push_back(to_string(1000000000ULL + hit * 2 + 1));
+        data.removeKeys.push_back(to_string(1000000000ULL + order[i] * 2));
+    }
+}
+
+// Writes the generated bids in the column layout of eBid_Monthly_Sales.csv
+// (title, id, ..., amount in column 4, ..., fund in column 8), so the labs'
+// own loaders can be timed end to end
+bool writeBidCsv(const string& path, const Dataset& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        cerr << "Unable to create " << path << endl;
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    fputs("ArticleTitle,ArticleID,Department,CloseDate,WinningBid,InventoryID,VehicleID,ReceiptNumber,Fund\n", file);
+    for (RowId row : data.rows) {
+        string_view bidId = data.store.BidId(row);
+        string_view title = data.store.Title(row);
+        string_view fund = data.store.Fund(row);
+        fprintf(file, "%.*s,%.*s,,,$%.2f,,,,%.*s\n", (int)title.size(), title.data(), (int)bidId.size(), bidId.data(),
+                data.store.Amount(row), (int)fund.size(), fund.data());
+    }
+    return fclose(file) == 0;
+}
+
+//============================================================================
+// Timing
+//============================================================================
+
+// Every timed interval and how many operations it covered
+struct OpTimings {
+    vector<double> nsPerOp; // mean of each interval
+    double seconds = 0;
+    size_t ops = 0;
+    size_t batchOps = 0; // the most operations one interval covered
+
+    void Add(double intervalSeconds, size_t intervalOps) {
+        nsPerOp.push_back(intervalSeconds * 1e9 / (double)max<size_t>(1, intervalOps));
+        seconds += intervalSeconds;
+        ops += intervalOps;
+        batchOps = max(batchOps, intervalOps);
+    }
+};
+
+struct Result {
+    string container;
+    string operation;
+    size_t rows;
+    size_t batchOps;
+    double p50Ns;
+    double p99Ns;
+    double opsPerSecond;
+};
+
+// Nearest-rank percentile
+double percentile(vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    sort(values.begin(), values.end());
+    size_t rank = (size_t)(fraction * (double)values.size() + 0.999999);
+    return values[min(values.size(), max<size_t>(1, rank)) - 1];
+}
+
+// Collects the timings of one container at one size, keyed by operation
+class Recorder {
+
+private:
+    vector<pair<string, OpTimings>> timings;
+    bool warmup = true;
+
+public:
+    // The first repetition of every benchmark only warms caches and pools
+    void StartRepetition(int repetition) {
+        warmup = repetition == 0;
+    }
+
+    void Add(const string& operation, double seconds, size_t ops) {
+        if (warmup) {
+            return;
+        }
+        for (pair<string, OpTimings>& entry : timings) {
+            if (entry.first == operation) {
+                entry.second.Add(seconds, ops);
+                return;
+            }
+        }
+        timings.emplace_back(operation, OpTimings());
+        timings.back().second.Add(seconds, ops);
+    }
+
+    void Report(const string& container, size_t rows, vector<Result>& results) const {
+        for (const pair<string, OpTimings>& entry : timings) {
+            const OpTimings& op = entry.second;
+            Result result;
+            result.container = container;
+            result.operation = entry.first;
+            result.rows = rows;
+            result.batchOps = op.batchOps;
+            result.p50Ns = percentile(op.nsPerOp, 0.50);
+            result.p99Ns = percentile(op.nsPerOp, 0.99);
+            result.opsPerSecond = op.seconds > 0 ? (double)op.ops / op.seconds : 0;
+            results.push_back(result);
+        }
+    }
+};
+
+// Times a whole pass over count items as one interval
+template <typename Work>
+void timeRun(Recorder& recorder, const string& operation, size_t count, Work work) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    work();
+    recorder.Add(operation, secondsSince(start), count);
+}
+
+// Times one call per key, BATCH_OPS keys to an interval
+template <typename Work>
+void timeBatches(Recorder& recorder, const string& operation, const vector<string>& keys, Work work) {
+    for (size_t first = 0; first < keys.size(); first += BATCH_OPS) {
+        size_t last = min(keys.size(), first + BATCH_OPS);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = first; i < last; i++) {
+            work(keys[i]);
+        }
+        recorder.Add(operation, secondsSince(start), last - first);
+    }
+}
+
+// Print walks write into a discarded stream, so traversal timings measure
+// the walk and formatting rather than the terminal
+template <typename Work>
+void timeSilently(Recorder& recorder, const string& operation, size_t count, Work work) {
+    NullStreamBuffer sink;
+    streambuf* console = cout.rdbuf(&sink);
+    timeRun(recorder, operation, count, work);
+    cout.rdbuf(console);
+}
+
+// Keeps search results alive so the compiler cannot drop the lookups
+size_t foundCount = 0;
+
+// Times one SearchBatch call per SEARCH_BATCH_KEYS keys, to compare with
+// the same keys looked up one Search at a time
+template <typename Index>
+void timeSearchBatches(Recorder& recorder, const string& operation, const vector<string>& keys, Index& index) {
+    vector<BidRef> found;
+    for (size_t first = 0; first < keys.size(); first += SEARCH_BATCH_KEYS) {
+        size_t last = min(keys.size(), first + SEARCH_BATCH_KEYS);
+        vector<string_view> batch(keys.begin() + first, keys.begin() + last);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        index.SearchBatch(batch, found);
+        recorder.Add(operation, secondsSince(start), last - first);
+        for (BidRef bid : found) {
+            foundCount += bid.valid();
+        }
+    }
+}
+
+//============================================================================
+// Benchmarks
+//============================================================================
+
+// load_csv runs the index's program loader (loadCsv) end to end on the
+// CSV file: map, parse, append to a fresh store and build. The other
+// operations share the generated store: build indexes its rows the way
+// that loader does, then come search hits and misses (one at a time and
+// batched), fund and amount queries, the in-order print walk, remove and
+// teardown of what is left. The fund and amount queries each visit every
+// row once (all funds, 100 amount ranges covering the generated 0-10000).
+template <typename Index, typename LoadCsv, typename Build, typename Walk>
+void benchmarkIndex(const string& name, Dataset& data, int repetitions, LoadCsv loadCsv, Build build, Walk walk, vector<Result>& results) {
+    size_t rows = data.rows.size();
+    Recorder recorder;
+    for (int repetition = 0; repetition <= repetitions; repetition++) {
+        recorder.StartRepetition(repetition);
+        {
+            BidStore csvStore;
+            unique_ptr<Index> loaded(new Index(&csvStore));
+            timeSilently(recorder, "load_csv", rows, [&]() { loadCsv(data.csvPath, &csvStore, loaded.get()); });
+        }
+
+        vector<RowId> input = data.rows;
+        unique_ptr<Index> index(new Index(&data.store));
+
+        timeRun(recorder, "build", rows, [&]() { build(*index, input); });
+        timeBatches(recorder, "search_hit", data.hitKeys, [&](const string& key) {
+            foundCount += index->Search(key).valid();
+        });
+        timeBatches(recorder, "search_miss", data.missKeys, [&](const string& key) {
+            foundCount += index->Search(key).valid();
+        });
+        timeSearchBatches(recorder, "search_batch_hit", data.hitKeys, *index);
+        timeSearchBatches(recorder, "search_batch_miss", data.missKeys, *index);
+        timeRun(recorder, "search_fund", rows, [&]() {
+            for (const char* fund : { "General Fund", "Enterprise", "Special Revenue", "Capital Projects" }) {
+                for (BidRef bid : index->SearchFund(fund)) {
+                    foundCount += bid.valid();
+                }
+            }
+        });
+        timeRun(recorder, "search_amount", rows, [&]() {
+            for (int range = 0; range < 100; range++) {
+                for (BidRef bid : index->SearchAmount(range * 100.0, range * 100.0 + 99.99)) {
+                    foundCount += bid.valid();
+                }
+            }
+        });
+        timeSilently(recorder, "traversal", rows, [&]() { walk(*index); });
+        timeBatches(recorder, "remove", data.removeKeys, [&](const string& key) {
+            index->Remove(key);
+        });
+        timeRun(recorder, "teardown", rows - data.removeKeys.size(), [&]() { index.reset(); });
+    }
+    recorder.Report(name, rows, results);
+}
+
+// load_csv is the lab's loader on the CSV file, into a fresh store. Each
+// sort runs on its own copy of the generated rows in generated order. The
+// display walk is the text export.
+void benchmarkVector(Dataset& data, int repetitions, vector<Result>& results) {
+    size_t rows = data.rows.size();
+    const BidStore* store = &data.store;
+    Recorder recorder;
+    for (int repetition = 0; repetition <= repetitions; repetition++) {
+        recorder.StartRepetition(repetition);
+        vector<RowId> bids;
+        {
+            BidStore csvStore;
+            LoadTimings timings;
+            vector<RowId> loaded;
+            timeSilently(recorder, "load_csv", rows, [&]() { loaded = loadBidCsv(data.csvPath, &csvStore, timings); });
+        }
+
+        if (rows <= MAX_SELECTION_SORT_ROWS) {
+            bids = data.rows;
+            timeRun(recorder, "selection_sort", rows, [&]() { sorting::selectionSort(store, bids); });
+        }
+        bids = data.rows;
+        timeRun(recorder, "quick_sort", rows, [&]() { sorting::quickSort(store, bids, 0, (int)bids.size() - 1); });
+        bids = data.rows;
+        timeRun(recorder, "parallel_sort", rows, [&]() { sorting::parallelSort(store, bids, loaderThreads()); });
+        bids = data.rows;
+        timeRun(recorder, "prefix_radix_sort", rows, [&]() { sorting::prefixRadixSort(store, bids); });
+        timeRun(recorder, "top_100_amount", rows, [&]() {
+            foundCount += sorting::topK(data.rows, 100, sorting::AmountGreater{ store }).size();
+        });
+        const pair<const char*, ExportFormat> formats[] = { { "export_text", EXPORT_TEXT }, { "export_csv", EXPORT_CSV }, { "export_jsonl", EXPORT_JSONL }, { "export_binary", EXPORT_BINARY } };
+        for (const pair<const char*, ExportFormat>& format : formats) {
+            timeSilently(recorder, format.first, rows, [&]() {
+                BidExporter out(cout, format.second);
+                for (RowId row : bids) {
+                    out.Write(BidRef(store, row));
+                }
+            });
+        }
+    }
+    recorder.Report("vector", rows, results);
+}
+
+// The snapshot as a read-only engine: open maps it and checks only the
+// header, open_verified adds the checksum and row checks a restore runs,
+// and searches go straight to the mapped id index. restore_hash_flat is
+// the other warm start, rebuilding a hash table from the same file.
+void benchmarkSnapshot(Dataset& data, int repetitions, vector<Result>& results) {
+    const string path = "BidBenchmark.snapshot";
+    size_t rows = data.rows.size();
+    if (!saveSnapshot(path, "benchmark", data.store, data.rows)) {
+        return;
+    }
+
+    Recorder recorder;
+    for (int repetition = 0; repetition <= repetitions; repetition++) {
+        recorder.StartRepetition(repetition);
+        BidSnapshot snapshot;
+        timeRun(recorder, "open_verified", 1, [&]() { snapshot.Open(path); });
+        timeRun(recorder, "open", 1, [&]() { snapshot.Open(path, false); });
+        timeBatches(recorder, "search_hit", data.hitKeys, [&](const string& key) {
+            foundCount += snapshot.Search(key) < snapshot.Size();
+        });
+        timeBatches(recorder, "search_miss", data.missKeys, [&](const string& key) {
+            foundCount += snapshot.Search(key) < snapshot.Size();
+        });
+        snapshot.Close();
+
+        BidStore store;
+        hashing::FlatHashTable<> table(&store);
+        timeSilently(recorder, "restore_hash_flat", rows, [&]() {
+            loadSnapshot(path, store, [&](vector<RowId>& restored, vector<RowId>&) {
+                table.reserve(restored.size());
+                for (RowId row : restored) {
+                    table.InsertRow(row);
+                }
+            });
+        });
+    }
+    recorder.Report("snapshot", rows, results);
+    remove(path.c_str());
+}
+
+// Each repetition replays the whole trace into an empty index over a
+// store of its own
+template <typename Index, typename Print>
+void benchmarkReplay(const string& name, const vector<TraceEvent>& events, int repetitions, Print print, vector<Result>& results) {
+    Recorder recorder;
+    for (int repetition = 0; repetition <= repetitions; repetition++) {
+        recorder.StartRepetition(repetition);
+        BidStore store;
+        unique_ptr<Index> index(new Index(&store));
+        ReplayStats stats = replayTrace(events, *index, print);
+        recorder.Add("replay", stats.seconds, stats.operations());
+        foundCount += stats.hits;
+    }
+    recorder.Report(name, events.size(), results);
+}
+
+void replayAll(const vector<TraceEvent>& events, int repetitions, vector<Result>& results) {
+    benchmarkReplay<hashing::HashTable<>>("hash_chained", events, repetitions, [](hashing::HashTable<>& table) { table.PrintAll(); }, results);
+    benchmarkReplay<hashing::FlatHashTable<>>("hash_flat", events, repetitions, [](hashing::FlatHashTable<>& table) { table.PrintAll(); }, results);
+    benchmarkReplay<hashing::ConcurrentHashTable<>>("hash_concurrent", events, repetitions, [](hashing::ConcurrentHashTable<>& table) { table.PrintAll(); }, results);
+    benchmarkReplay<trees::BinarySearchTree<>>("bst", events, repetitions, [](trees::BinarySearchTree<>& tree) { tree.InOrder(); }, results);
+    benchmarkReplay<trees::BalancedBinarySearchTree<>>("avl", events, repetitions, [](trees::BalancedBinarySearchTree<>& tree) { tree.InOrder(); }, results);
+    benchmarkReplay<trees::BPlusTree>("bplus", events, repetitions, [](trees::BPlusTree& tree) { tree.InOrder(); }, results);
+}
+
+void printJson(const vector<Result>& results, int repetitions) {
+    cout << "{\n  \"repetitions\": " << repetitions << ",\n  \"threads\": " << loaderThreads() << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        cout << "    {\"container\": \"" << result.container << "\", \"operation\": \"" << result.operation
+             << "\", \"rows\": " << result.rows << ", \"batch_ops\": " << result.batchOps << ", \"batch_mean_p50_ns\": " << result.p50Ns
+             << ", \"batch_mean_p99_ns\": " << result.p99Ns
+             << ", \"ops_per_sec\": " << result.opsPerSecond << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "  ]\n}" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxRows = 1000000;
+    int repetitions = 5;
+    vector<Result> results;
+
+    if (argc >= 7 && string(argv[1]) == "--generate-trace") {
+        TraceOptions options;
+        options.keys = strtoull(argv[3], nullptr, 10);
+        options.operations = strtoull(argv[4], nullptr, 10);
+        options.skew = atof(argv[5]);
+        string order = argv[6];
+        options.order = order == "sorted" ? SORTED_ORDER : order == "reverse" ? REVERSE_ORDER : SHUFFLED_ORDER;
+        if (argc > 7) {
+            options.printEvery = strtoull(argv[7], nullptr, 10);
+        }
+        return generateTrace(argv[2], options) ? 0 : 1;
+    }
+    if (argc >= 3 && string(argv[1]) == "--replay-trace") {
+        vector<TraceEvent> events;
+        if (!readTrace(argv[2], events)) {
+            return 1;
+        }
+        if (argc > 3) {
+            repetitions = max(1, atoi(argv[3]));
+        }
+        cerr << "replaying " << events.size() << " operations" << endl;
+        replayAll(events, repetitions, results);
+        printJson(results, repetitions);
+        cerr << "found " << foundCount << endl;
+        return 0;
+    }
+
+    if (argc > 1) {
+        maxRows = strtoull(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        repetitions = max(1, atoi(argv[2]));
+    }
+
+    // The labs' loaders, for the load_csv timings
+    auto loadHashTable = [](const string& path, BidStore* store, auto* table) { hashing::loadBids(path, store, table); };
+    auto loadTree = [](const string& path, BidStore* store, auto* tree) { trees::loadBids(path, store, tree); };
+
+    Dataset data;
+    data.csvPath = "BidBenchmark.csv";
+    for (size_t rows = 1000; rows <= maxRows; rows *= 10) {
+        cerr << "generating " << rows << " bids" << endl;
+        generateBids(data, rows, 42);
+        if (!writeBidCsv(data.csvPath, data)) {
+            return 1;
+        }
+
+        cerr << "  vector" << endl;
+        benchmarkVector(data, repetitions, results);
+
+        cerr << "  hash tables" << endl;
+        benchmarkIndex<hashing::HashTable<>>("hash_chained", data, repetitions, loadHashTable, [](hashing::HashTable<>& table, vector<RowId>& rows) {
+            table.reserve((unsigned int)rows.size());
+            for (RowId row : rows) {
+                table.InsertRow(row);
+            }
+        }, [](hashing::HashTable<>& table) { table.PrintAll(); }, results);
+        // The same table on plain new/delete, against the node pool above
+        benchmarkIndex<hashing::HashTable<hashing::BidIdHasher, HeapAllocator>>("hash_chained_heap", data, repetitions, loadHashTable, [](hashing::HashTable<hashing::BidIdHasher, HeapAllocator>& table, vector<RowId>& rows) {
+            table.reserve((unsigned int)rows.size());
+            for (RowId row : rows) {
+                table.InsertRow(row);
+            }
+        }, [](hashing::HashTable<hashing::BidIdHasher, HeapAllocator>& table) { table.PrintAll(); }, results);
+        benchmarkIndex<hashing::FlatHashTable<>>("hash_flat", data, repetitions, loadHashTable, [](hashing::FlatHashTable<>& table, vector<RowId>& rows) {
+            table.reserve(rows.size());
+            for (RowId row : rows) {
+                table.InsertRow(row);
+            }
+        }, [](hashing::FlatHashTable<>& table) { table.PrintAll(); }, results);
+        benchmarkIndex<hashing::ConcurrentHashTable<>>("hash_concurrent", data, repetitions, loadHashTable, [](hashing::ConcurrentHashTable<>& table, vector<RowId>& rows) {
+            table.reserve((unsigned int)rows.size());
+            for (RowId row : rows) {
+                table.InsertRow(row);
+            }
+        }, [](hashing::ConcurrentHashTable<>& table) { table.PrintAll(); }, results);
+
+        cerr << "  trees" << endl;
+        benchmarkIndex<trees::BinarySearchTree<>>("bst", data, repetitions, loadTree, [](trees::BinarySearchTree<>& tree, vector<RowId>& rows) {
+            tree.BulkLoad(rows);
+        }, [](trees::BinarySearchTree<>& tree) { tree.InOrder(); }, results);
+        benchmarkIndex<trees::BinarySearchTree<HeapAllocator>>("bst_heap", data, repetitions, loadTree, [](trees::BinarySearchTree<HeapAllocator>& tree, vector<RowId>& rows) {
+            tree.BulkLoad(rows);
+        }, [](trees::BinarySearchTree<HeapAllocator>& tree) { tree.InOrder(); }, results);
+        benchmarkIndex<trees::BalancedBinarySearchTree<>>("avl", data, repetitions, loadTree, [](trees::BalancedBinarySearchTree<>& tree, vector<RowId>& rows) {
+            tree.BulkLoad(rows);
+        }, [](trees::BalancedBinarySearchTree<>& tree) { tree.InOrder(); }, results);
+        benchmarkIndex<trees::BalancedBinarySearchTree<HeapAllocator>>("avl_heap", data, repetitions, loadTree, [](trees::BalancedBinarySearchTree<HeapAllocator>& tree, vector<RowId>& rows) {
+            tree.BulkLoad(rows);
+        }, [](trees::BalancedBinarySearchTree<HeapAllocator>& tree) { tree.InOrder(); }, results);
+        benchmarkIndex<trees::BPlusTree>("bplus", data, repetitions, loadTree, [](trees::BPlusTree& tree, vector<RowId>& rows) {
+            tree.BulkLoad(rows);
+        }, [](trees::BPlusTree& tree) { tree.InOrder(); }, results);
+
+        cerr << "  snapshot" << endl;
+        benchmarkSnapshot(data, repetitions, results);
+    }
+    remove(data.csvPath.c_str());
+
+    printJson(results, repetitions);
+    cerr << "found " << foundCount << endl;
+    return 0;
+}
@@ -0,0 +1,346 @@
+//============================================================================
+// Name        : BidExport.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Buffered bid export as text, CSV, JSON lines or binary
+//============================================================================
+
+#ifndef BIDEXPORT_HPP
+#define BIDEXPORT_HPP
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BidStore.hpp"
+#include "BidTrace.hpp"
+#include "MappedCsv.hpp"
+
+enum ExportFormat {
+    EXPORT_TEXT,   // the "id: title | amount | fund" lines displayBid prints
+    EXPORT_CSV,    // bidId,title,fund,amount with a header row
+    EXPORT_JSONL,  // one JSON object per line
+    EXPORT_BINARY  // trace insert records, so readTrace loads it back
+};
+
+inline bool parseExportFormat(const std::string& name, ExportFormat& format) {
+    if (name == "text") {
+        format = EXPORT_TEXT;
+    }
+    else if (name == "csv") {
+        format = EXPORT_CSV;
+    }
+    else if (name == "jsonl") {
+        format = EXPORT_JSONL;
+    }
+    else if (name == "binary") {
+        format = EXPORT_BINARY;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Formats bids straight into a 1 MB buffer and hands it to the file or
+// stream a block at a time, so a million rows cost a few dozen writes
+// instead of a flush per row. Numbers go through to_chars rather than
+// iostream formatting. A stream target is written through its current
+// streambuf, so redirecting cout (as trace replay does) still works.
+class BidExporter {
+
+private:
+    static const size_t BUFFER_BYTES = 1 << 20;
+
+    FILE* file = nullptr;
+    std::ostream* stream = nullptr;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t rows = 0;
+    size_t bytes = 0;
+    bool failed = false;
+    ExportFormat format = EXPORT_TEXT;
+
+    void flushBuffer() {
+        if (used == 0) {
+            return;
+        }
+        if (file != nullptr) {
+            failed |= fwrite(buffer.data(), 1, used, file) != used;
+        }
+        else if (stream != nullptr) {
+            failed |= !stream->write(buffer.data(), (std::streamsize)used);
+        }
+        bytes += used;
+        used = 0;
+    }
+
+    // Room for length more bytes; anything longer than the whole buffer
+    // is written straight through
+    char* reserve(size_t length) {
+        if (used + length > buffer.size()) {
+            flushBuffer();
+        }
+        return length <= buffer.size() ? buffer.data() + used : nullptr;
+    }
+
+    void put(std::string_view text) {
+        char* out = reserve(text.size());
+        if (out == nullptr) {
+            if (file != nullptr) {
+                failed |= fwrite(text.data(), 1, text.size(), file) != text.size();
+            }
+            else if (stream != nullptr) {
+                failed |= !stream->write(text.data(), (std::streamsize)text.size());
+            }
+            bytes += text.size();
+            return;
+        }
+        memcpy(out, text.data(), text.size());
+        used += text.size();
+    }
+
+    void put(char c) {
+        put(std::string_view(&c, 1));
+    }
+
+    // Shortest text that reads back as the same double, or the 6
+    // significant digits cout prints by default for the text format
+    void putAmount(double amount, bool shortest) {
+        char* out = reserve(32);
+        std::to_chars_result result = shortest ? std::to_chars(out, out + 32, amount)
+                                               : std::to_chars(out, out + 32, amount, std::chars_format::general, 6);
+        used += (size_t)(result.ptr - out);
+    }
+
+    void putLength(size_t length) {
+        do {
+            uint8_t byte = (uint8_t)(length & 0x7F);
+            length >>= 7;
+            put((char)(length > 0 ? (byte | 0x80) : byte));
+        } while (length > 0);
+    }
+
+    // Quoted only when it has to be, with quotes doubled
+    void putCsvField(std::string_view field) {
+        if (field.find_first_of(",\"\r\n") == std::string_view::npos) {
+            put(field);
+            return;
+        }
+        put('"');
+        size_t start = 0;
+        for (size_t quote = field.find('"'); quote != std::string_view::npos; quote = field.find('"', start)) {
+            put(field.substr(start, quote + 1 - start));
+            put('"');
+            start = quote + 1;
+        }
+        put(field.substr(start));
+        put('"');
+    }
+
+    void putJsonString(std::string_view text) {
+        static const char HEX[] = "0123456789abcdef";
+        put('"');
+        size_t start = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned char c = (unsigned char)text[i];
+            if (c != '"' && c != '\\' && c >= 0x20) {
+                continue;
+            }
+            put(text.substr(start, i - start));
+            start = i + 1;
+            put('\\');
+            switch (c) {
+            case '"':
+                put('"');
+                break;
+            case '\\':
+                put('\\');
+                break;
+            case '\n':
+                put('n');
+                break;
+            case '\r':
+                put('r');
+                break;
+            case '\t':
+                put('t');
+                break;
+            default:
+                put("u00");
+                put(HEX[c >> 4]);
+                put(HEX[c & 0xF]);
+            }
+        }
+        put(text.substr(start));
+        put('"');
+    }
+
+    void begin(ExportFormat exportFormat) {
+        format = exportFormat;
+        buffer.resize(BUFFER_BYTES);
+        used = 0;
+        rows = 0;
+        bytes = 0;
+        failed = false;
+        if (format == EXPORT_CSV) {
+            put("bidId,title,fund,amount\n");
+        }
+        else if (format == EXPORT_BINARY) {
+            put(std::string_view(TRACE_MAGIC, sizeof(TRACE_MAGIC)));
+        }
+    }
+
+public:
+    BidExporter() = default;
+    BidExporter(const BidExporter&) = delete;
+    BidExporter& operator=(const BidExporter&) = delete;
+
+    BidExporter(std::ostream& out, ExportFormat exportFormat = EXPORT_TEXT) {
+        stream = &out;
+        begin(exportFormat);
+    }
+
+    virtual ~BidExporter() {
+        Close();
+    }
+
+    // Exports to path, or to stdout (through cout) when path is "-"
+    bool Open(const std::string& path, ExportFormat exportFormat) {
+        Close();
+        if (path == "-") {
+            stream = &std::cout;
+        }
+        else {
+            file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                return false;
+            }
+        }
+        begin(exportFormat);
+        return true;
+    }
+
+    void Write(BidRef bid) {
+        switch (format) {
+        case EXPORT_TEXT:
+            put(bid.bidId());
+            put(": ");
+            put(bid.title());
+            put(" | ");
+            putAmount(bid.amount(), false);
+            put(" | ");
+            put(bid.fund());
+            put('\n');
+            break;
+        case EXPORT_CSV:
+            putCsvField(bid.bidId());
+            put(',');
+            putCsvField(bid.title());
+            put(',');
+            putCsvField(bid.fund());
+            put(',');
+            putAmount(bid.amount(), true);
+            put('\n');
+            break;
+        case EXPORT_JSONL:
+            put("{\"bidId\": ");
+            putJsonString(bid.bidId());
+            put(", \"title\": ");
+            putJsonString(bid.title());
+            put(", \"fund\": ");
+            putJsonString(bid.fund());
+            put(", \"amount\": ");
+            if (std::isfinite(bid.amount())) {
+                putAmount(bid.amount(), true);
+            }
+            else {
+                put("null");
+            }
+            put("}\n");
+            break;
+        case EXPORT_BINARY: {
+            double amount = bid.amount();
+            put((char)TRACE_INSERT);
+            putLength(bid.bidId().size());
+            put(bid.bidId());
+            putLength(bid.title().size());
+            put(bid.title());
+            putLength(bid.fund().size());
+            put(bid.fund());
+            put(std::string_view(reinterpret_cast<const char*>(&amount), sizeof(amount)));
+            break;
+        }
+        }
+        rows++;
+    }
+
+    size_t Rows() const {
+        return rows;
+    }
+
+    // Bytes handed to the file or stream so far
+    size_t Bytes() const {
+        return bytes + used;
+    }
+
+    // Flushes everything; false if any write failed. A file is closed, a
+    // stream is only flushed.
+    bool Close() {
+        flushBuffer();
+        if (file != nullptr) {
+            failed |= fclose(file) != 0;
+            file = nullptr;
+        }
+        else if (stream != nullptr) {
+            failed |= !stream->flush();
+            stream = nullptr;
+        }
+        return !failed;
+    }
+};
+
+// The menus' Export option: asks for a path and format, then writes every
+// bid forEach visits and reports the throughput
+template <typename ForEach>
+void exportFromMenu(ForEach forEach) {
+    std::string path;
+    std::string formatName;
+    ExportFormat format;
+    std::cout << "Enter export file (- for the console): ";
+    std::cin >> path;
+    std::cout << "Enter format (text, csv, jsonl, binary): ";
+    std::cin >> formatName;
+    if (!parseExportFormat(formatName, format)) {
+        std::cout << "Unknown format " << formatName << std::endl;
+        return;
+    }
+
+    BidExporter out;
+    if (!out.Open(path, format)) {
+        std::cerr << "Unable to create " << path << std::endl;
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    forEach([&](BidRef bid) { out.Write(bid); });
+    bool ok = out.Close();
+    double seconds = secondsSince(start);
+
+    std::cout << out.Rows() << " bids, " << out.Bytes() << " bytes exported in " << seconds << " seconds";
+    if (seconds > 0) {
+        std::cout << " (" << out.Bytes() / seconds / (1 << 20) << " MB/sec)";
+    }
+    std::cout << std::endl;
+    if (!ok) {
+        std::cerr << "Write to " << path << " failed" << std::endl;
+    }
+}
+
+#endif // BIDEXPORT_HPP
@@ -0,0 +1,435 @@
+//============================================================================
+// Name        : BidIndex.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Secondary indexes on fund and amount for the bid containers
+//============================================================================
+
+#ifndef BIDINDEX_HPP
+#define BIDINDEX_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "BidExport.hpp"
+#include "BidStore.hpp"
+#include "MappedCsv.hpp"
+
+// Walks index entries (row ids) as BidRefs over the shared store, so a
+// query copies no bids
+template <typename Base>
+class IndexIterator {
+
+private:
+    const BidStore* store = nullptr;
+    Base position;
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef BidRef value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const BidRef* pointer;
+    typedef BidRef reference;
+
+    IndexIterator() = default;
+
+    IndexIterator(const BidStore* bidStore, Base at) : store(bidStore), position(at) {
+    }
+
+    BidRef operator*() const {
+        return BidRef(store, *position);
+    }
+
+    IndexIterator& operator++() {
+        ++position;
+        return *this;
+    }
+
+    bool operator==(const IndexIterator& other) const {
+        return position == other.position;
+    }
+
+    bool operator!=(const IndexIterator& other) const {
+        return position != other.position;
+    }
+};
+
+// Half-open [begin, end) view returned by the index queries
+template <typename Base>
+struct IndexRange {
+    IndexIterator<Base> first;
+    IndexIterator<Base> last;
+
+    IndexIterator<Base> begin() const {
+        return first;
+    }
+
+    IndexIterator<Base> end() const {
+        return last;
+    }
+
+    bool empty() const {
+        return first == last;
+    }
+};
+
+// A query result that owns its row list, for queries that gather rows
+// rather than walk one index in place. Copies share the list.
+struct RowListRange : IndexRange<std::vector<RowId>::const_iterator> {
+    std::shared_ptr<const std::vector<RowId>> rows;
+};
+
+// Row -> position in its fund's list, shared by the shards of one
+// ShardedBidIndex. Slots live in fixed blocks allocated on first use, so
+// one thread claiming a block never moves a slot another is writing; each
+// row's slot is only touched under the lock of the shard that holds it.
+class RowSlots {
+
+private:
+    static constexpr unsigned int BLOCK_BITS = 16;
+    static constexpr size_t BLOCK_ROWS = size_t(1) << BLOCK_BITS;
+    static constexpr size_t BLOCKS = size_t(1) << (32 - BLOCK_BITS);
+
+    std::unique_ptr<std::atomic<uint32_t*>[]> blocks;
+
+public:
+    RowSlots() : blocks(new std::atomic<uint32_t*>[BLOCKS]) {
+        for (size_t i = 0; i < BLOCKS; i++) {
+            blocks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~RowSlots() {
+        for (size_t i = 0; i < BLOCKS; i++) {
+            delete[] blocks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    RowSlots(const RowSlots&) = delete;
+    RowSlots& operator=(const RowSlots&) = delete;
+
+    uint32_t& operator[](RowId row) {
+        std::atomic<uint32_t*>& block = blocks[row >> BLOCK_BITS];
+        uint32_t* slots = block.load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            uint32_t* fresh = new uint32_t[BLOCK_ROWS]();
+            if (block.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                slots = fresh;
+            }
+            else {
+                delete[] fresh;
+            }
+        }
+        return slots[row & (BLOCK_ROWS - 1)];
+    }
+};
+
+// Bids by fund (hashed) and by amount (ordered) over the rows one
+// container holds. The container calls Add for every row it indexes and
+// Remove for every row it drops, so the primary bidId index and these
+// always agree. Query results stay valid until the next Add, Remove or
+// Clear.
+//
+// Added amounts are staged and merged into the ordered set in sorted order
+// by the next amount query: inserting a load's rows one at a time in random
+// order costs about four times as much. Removing a row still staged only
+// marks it, for the merge to skip, so removal never pays for a merge. Since
+// the merge happens inside Amount, two threads must not query at once.
+class BidSecondaryIndex {
+
+private:
+    // Orders rows by amount, then row id so equal amounts stay distinct.
+    // Transparent, so a plain amount can bound a range.
+    struct AmountOrder {
+        typedef void is_transparent;
+        const BidStore* store;
+
+        bool operator()(RowId a, RowId b) const {
+            double left = store->Amount(a);
+            double right = store->Amount(b);
+            return left < right || (left == right && a < b);
+        }
+
+        bool operator()(RowId row, double amount) const {
+            return store->Amount(row) < amount;
+        }
+
+        bool operator()(double amount, RowId row) const {
+            return amount < store->Amount(row);
+        }
+    };
+
+    typedef std::vector<RowId> FundRows;
+    typedef std::set<RowId, AmountOrder> AmountRows;
+
+    const BidStore* store;
+    // Keys view the store's interned fund names, which outlive the index
+    std::unordered_map<std::string_view, FundRows> byFund;
+    std::vector<uint32_t> fundSlot; // row -> its position in its fund's list
+    RowSlots* sharedSlots = nullptr; // used instead of fundSlot when set
+    mutable AmountRows byAmount;
+    mutable std::vector<RowId> staged; // added, not yet merged into byAmount
+    mutable std::unordered_set<RowId> unstaged; // staged, then removed
+
+    static const FundRows& noRows() {
+        static const FundRows empty;
+        return empty;
+    }
+
+    // NaN has no place in an ordering; such rows are left out of byAmount
+    bool ordered(RowId row) const {
+        return !std::isnan(store->Amount(row));
+    }
+
+    void merge() const {
+        if (staged.empty()) {
+            return;
+        }
+        std::sort(staged.begin(), staged.end(), byAmount.key_comp());
+        // Sorted input makes each insert's hint the end or the element just
+        // after the previous insert, which is usually right
+        AmountRows::iterator hint = byAmount.end();
+        for (RowId row : staged) {
+            if (unstaged.empty() || unstaged.count(row) == 0) {
+                hint = std::next(byAmount.insert(hint, row));
+            }
+        }
+        std::vector<RowId>().swap(staged);
+        unstaged.clear();
+    }
+
+    uint32_t& slotOf(RowId row) {
+        if (sharedSlots != nullptr) {
+            return (*sharedSlots)[row];
+        }
+        if (row >= fundSlot.size()) {
+            fundSlot.resize(std::max<size_t>(row + 1, fundSlot.size() * 2));
+        }
+        return fundSlot[row];
+    }
+
+    void addToFund(RowId row) {
+        FundRows& rows = byFund[store->Fund(row)];
+        slotOf(row) = (uint32_t)rows.size();
+        rows.push_back(row);
+    }
+
+public:
+    typedef IndexRange<FundRows::const_iterator> FundRange;
+    typedef IndexRange<AmountRows::const_iterator> AmountRange;
+
+    explicit BidSecondaryIndex(const BidStore* bidStore) : store(bidStore), byAmount(AmountOrder{ bidStore }) {
+    }
+
+    // Keeps fund positions in slots, which other indexes over disjoint
+    // rows may share
+    BidSecondaryIndex(const BidStore* bidStore, RowSlots* slots) : store(bidStore), sharedSlots(slots), byAmount(AmountOrder{ bidStore }) {
+    }
+
+    BidSecondaryIndex(const BidSecondaryIndex&) = delete;
+    BidSecondaryIndex& operator=(const BidSecondaryIndex&) = delete;
+
+    void Add(RowId row) {
+        addToFund(row);
+        if (ordered(row)) {
+            staged.push_back(row);
+            if (!unstaged.empty()) {
+                unstaged.erase(row);
+            }
+        }
+    }
+
+    void AddRows(const std::vector<RowId>& rows) {
+        staged.reserve(staged.size() + rows.size());
+        for (RowId row : rows) {
+            Add(row);
+        }
+    }
+
+    // The row must still be in the store, since its keys are read back.
+    // The last row of its fund takes its place, so removal is O(1) there.
+    void Remove(RowId row) {
+        std::unordered_map<std::string_view, FundRows>::iterator fund = byFund.find(store->Fund(row));
+        if (fund == byFund.end() || (sharedSlots == nullptr && row >= fundSlot.size())) {
+            return;
+        }
+        FundRows& rows = fund->second;
+        uint32_t slot = slotOf(row);
+        if (slot >= rows.size() || rows[slot] != row) {
+            return;
+        }
+        rows[slot] = rows.back();
+        slotOf(rows[slot]) = slot;
+        rows.pop_back();
+        if (rows.empty()) {
+            byFund.erase(fund);
+        }
+        if (ordered(row) && byAmount.erase(row) == 0) {
+            unstaged.insert(row);
+            // Once most staged rows are dead, drop them in one linear pass,
+            // so churn with no queries in between stays bounded
+            if (unstaged.size() * 2 > staged.size()) {
+                staged.erase(std::remove_if(staged.begin(), staged.end(), [this](RowId dead) {
+                    return unstaged.count(dead) != 0;
+                }), staged.end());
+                unstaged.clear();
+            }
+        }
+    }
+
+    void Clear() {
+        byFund.clear();
+        fundSlot.clear();
+        byAmount.clear();
+        std::vector<RowId>().swap(staged);
+        unstaged.clear();
+    }
+
+    // Every bid for fund, in no particular order
+    FundRange Fund(std::string_view fund) const {
+        std::unordered_map<std::string_view, FundRows>::const_iterator found = byFund.find(fund);
+        const FundRows& rows = found != byFund.end() ? found->second : noRows();
+        return { IndexIterator<FundRows::const_iterator>(store, rows.begin()), IndexIterator<FundRows::const_iterator>(store, rows.end()) };
+    }
+
+    // Every bid with low <= amount <= high, smallest amount first
+    AmountRange Amount(double low, double high) const {
+        merge();
+        AmountRows::const_iterator first = byAmount.lower_bound(low);
+        // NaN bounds match nothing, as an empty range does
+        AmountRows::const_iterator last = low <= high ? byAmount.upper_bound(high) : first;
+        return { IndexIterator<AmountRows::const_iterator>(store, first), IndexIterator<AmountRows::const_iterator>(store, last) };
+    }
+
+    size_t FundCount() const {
+        return byFund.size();
+    }
+};
+
+// One BidSecondaryIndex per lock stripe of a concurrent container, so
+// writers holding different stripes never share a lock to update it. The
+// container passes each row to Shard(n) for a fixed n, under the lock that
+// guards that shard. Queries take that same lock one shard at a time, via
+// lockShard(n), and gather the matches into a list the result owns, so
+// they may run on any number of threads alongside writers.
+class ShardedBidIndex {
+
+private:
+    const BidStore* store;
+    RowSlots slots;
+    std::vector<std::unique_ptr<BidSecondaryIndex>> shards;
+
+    RowListRange own(std::shared_ptr<std::vector<RowId>> rows) const {
+        RowListRange range;
+        range.first = IndexIterator<std::vector<RowId>::const_iterator>(store, rows->cbegin());
+        range.last = IndexIterator<std::vector<RowId>::const_iterator>(store, rows->cend());
+        range.rows = std::move(rows);
+        return range;
+    }
+
+public:
+    typedef RowListRange FundRange;
+    typedef RowListRange AmountRange;
+
+    ShardedBidIndex(const BidStore* bidStore, size_t count) : store(bidStore) {
+        shards.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            shards.emplace_back(new BidSecondaryIndex(bidStore, &slots));
+        }
+    }
+
+    ShardedBidIndex(const ShardedBidIndex&) = delete;
+    ShardedBidIndex& operator=(const ShardedBidIndex&) = delete;
+
+    BidSecondaryIndex& Shard(size_t n) {
+        return *shards[n];
+    }
+
+    // Every bid for fund, in no particular order
+    template <typename LockShard>
+    FundRange Fund(std::string_view fund, LockShard lockShard) const {
+        std::shared_ptr<std::vector<RowId>> rows = std::make_shared<std::vector<RowId>>();
+        for (size_t n = 0; n < shards.size(); n++) {
+            std::unique_lock<std::mutex> held = lockShard(n);
+            for (BidRef bid : shards[n]->Fund(fund)) {
+                rows->push_back(bid.row);
+            }
+        }
+        return own(std::move(rows));
+    }
+
+    // Every bid with low <= amount <= high, smallest amount first
+    template <typename LockShard>
+    AmountRange Amount(double low, double high, LockShard lockShard) const {
+        std::shared_ptr<std::vector<RowId>> rows = std::make_shared<std::vector<RowId>>();
+        for (size_t n = 0; n < shards.size(); n++) {
+            std::unique_lock<std::mutex> held = lockShard(n);
+            for (BidRef bid : shards[n]->Amount(low, high)) {
+                rows->push_back(bid.row);
+            }
+        }
+        const BidStore* bidStore = store;
+        std::sort(rows->begin(), rows->end(), [bidStore](RowId a, RowId b) {
+            double left = bidStore->Amount(a);
+            double right = bidStore->Amount(b);
+            return left < right || (left == right && a < b);
+        });
+        return own(std::move(rows));
+    }
+};
+
+// The menus' fund and amount queries: prompt, write the matches through one
+// buffered exporter and report how many there were and how long it took.
+// search is the container's SearchFund or SearchAmount.
+template <typename SearchFund>
+void fundQueryFromMenu(SearchFund search) {
+    std::string fund;
+    std::cout << "Enter fund: ";
+    std::getline(std::cin >> std::ws, fund);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BidExporter out(std::cout);
+    for (BidRef bid : search(fund)) {
+        out.Write(bid);
+    }
+    out.Close();
+    double seconds = secondsSince(start);
+    std::cout << out.Rows() << " bids for " << fund << std::endl;
+    std::cout << "time: " << seconds << " seconds" << std::endl;
+}
+
+template <typename SearchAmount>
+void amountQueryFromMenu(SearchAmount search) {
+    double low = 0;
+    double high = 0;
+    std::cout << "Enter lowest amount: ";
+    std::cin >> low;
+    std::cout << "Enter highest amount: ";
+    std::cin >> high;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BidExporter out(std::cout);
+    for (BidRef bid : search(low, high)) {
+        out.Write(bid);
+    }
+    out.Close();
+    double seconds = secondsSince(start);
+    std::cout << out.Rows() << " bids in range" << std::endl;
+    std::cout << "time: " << seconds << " seconds" << std::endl;
+}
+
+#endif // BIDINDEX_HPP
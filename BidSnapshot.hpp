@@ -0,0 +1,467 @@
+//============================================================================
+// Name        : BidSnapshot.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Checksummed binary snapshots of loaded bids for warm starts
+//============================================================================
+
+#ifndef BIDSNAPSHOT_HPP
+#define BIDSNAPSHOT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "BidStore.hpp"
+#include "MappedCsv.hpp"
+
+// A snapshot is one header followed by three 8-byte aligned sections:
+//   rows     SnapshotRow per bid, in the order the saving container held them
+//   byId     uint32_t row numbers sorted by bidId, for binary search
+//   strings  every id, title and fund, funds stored once each
+// Rows refer to strings by offset from the start of the strings section,
+// never by address, so the file can be mapped anywhere and read in place.
+// Integers are in the byte order of the machine that wrote the file.
+const char SNAPSHOT_MAGIC[8] = { 'B', 'I', 'D', 'S', 'N', 'A', 'P', '1' };
+const uint32_t SNAPSHOT_VERSION = 2; // 2: the checksum covers the header
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t rows;
+    uint64_t rowsOffset;
+    uint64_t byIdOffset;
+    uint64_t stringsOffset;
+    uint64_t stringBytes;
+    uint64_t fileBytes;
+    uint64_t checksum; // over the whole file, with this field read as zero
+    char container[16]; // which index saved it, for the curious
+};
+
+// A string is its offset in the top 40 bits and its length in the low 24
+struct SnapshotRow {
+    uint64_t bidId;
+    uint64_t title;
+    uint64_t fund;
+    double amount;
+};
+
+const uint64_t SNAPSHOT_MAX_STRING = (1u << 24) - 1;
+const uint64_t SNAPSHOT_MAX_STRINGS = 1ULL << 40;
+
+// Hashes 8 bytes per step, so checking a snapshot runs near memory speed.
+// Bytes can arrive in any split; a short tail is zero-padded at the end.
+class SnapshotChecksum {
+
+private:
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint64_t pending = 0;
+    size_t pendingBytes = 0;
+
+    void mix(uint64_t word) {
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+public:
+    void Add(const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (length > 0 && pendingBytes > 0) {
+            pending |= (uint64_t)*bytes++ << (8 * pendingBytes);
+            length--;
+            if (++pendingBytes == 8) {
+                mix(pending);
+                pending = 0;
+                pendingBytes = 0;
+            }
+        }
+        for (; length >= 8; bytes += 8, length -= 8) {
+            uint64_t word;
+            memcpy(&word, bytes, 8);
+            mix(word);
+        }
+        for (size_t i = 0; i < length; i++) {
+            pending |= (uint64_t)bytes[i] << (8 * pendingBytes++);
+        }
+    }
+
+    uint64_t Finish() {
+        if (pendingBytes > 0) {
+            mix(pending);
+            pending = 0;
+            pendingBytes = 0;
+        }
+        return hash;
+    }
+};
+
+// Writes rows (a container's bids, in its own order) from store to path.
+// The checksum only reaches the header after everything else is written,
+// so a snapshot cut short never validates.
+inline bool saveSnapshot(const std::string& path, const std::string& container, const BidStore& store, const std::vector<RowId>& rows) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Unable to create " << path << std::endl;
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.headerBytes = sizeof(SnapshotHeader);
+    header.rows = rows.size();
+    strncpy(header.container, container.c_str(), sizeof(header.container) - 1);
+
+    // Lay out the strings first; funds are interned in the store, so one
+    // copy per distinct fund pointer is enough
+    std::vector<SnapshotRow> records(rows.size());
+    std::vector<std::string_view> strings;
+    std::unordered_map<const char*, uint64_t> funds;
+    uint64_t stringBytes = 0;
+    bool fits = true;
+    auto place = [&](std::string_view text) {
+        uint64_t ref = stringBytes << 24 | text.size();
+        fits &= text.size() <= SNAPSHOT_MAX_STRING;
+        strings.push_back(text);
+        stringBytes += text.size();
+        return ref;
+    };
+    for (size_t i = 0; i < rows.size(); i++) {
+        std::string_view fund = store.Fund(rows[i]);
+        std::unordered_map<const char*, uint64_t>::iterator known = funds.find(fund.data());
+        if (known == funds.end()) {
+            known = funds.emplace(fund.data(), place(fund)).first;
+        }
+        records[i].bidId = place(store.BidId(rows[i]));
+        records[i].title = place(store.Title(rows[i]));
+        records[i].fund = known->second;
+        records[i].amount = store.Amount(rows[i]);
+    }
+    if (!fits || stringBytes >= SNAPSHOT_MAX_STRINGS || rows.size() > UINT32_MAX) {
+        std::cerr << "Bids too large for a snapshot" << std::endl;
+        fclose(file);
+        remove(path.c_str());
+        return false;
+    }
+
+    std::vector<uint32_t> byId(rows.size());
+    for (size_t i = 0; i < byId.size(); i++) {
+        byId[i] = (uint32_t)i;
+    }
+    std::stable_sort(byId.begin(), byId.end(), [&](uint32_t a, uint32_t b) {
+        return store.BidId(rows[a]) < store.BidId(rows[b]);
+    });
+
+    auto aligned = [](uint64_t offset) {
+        return (offset + 7) & ~(uint64_t)7;
+    };
+    header.rowsOffset = sizeof(SnapshotHeader);
+    header.byIdOffset = aligned(header.rowsOffset + records.size() * sizeof(SnapshotRow));
+    header.stringsOffset = aligned(header.byIdOffset + byId.size() * sizeof(uint32_t));
+    header.stringBytes = stringBytes;
+    header.fileBytes = header.stringsOffset + stringBytes;
+
+    SnapshotChecksum checksum;
+    checksum.Add(&header, sizeof(header));
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    auto write = [&](const void* data, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        ok &= fwrite(data, 1, length, file) == length;
+        checksum.Add(data, length);
+        written += length;
+    };
+    auto pad = [&](uint64_t offset) {
+        static const char zeros[8] = {};
+        write(zeros, (size_t)(offset - written));
+    };
+    write(records.data(), records.size() * sizeof(SnapshotRow));
+    pad(header.byIdOffset);
+    write(byId.data(), byId.size() * sizeof(uint32_t));
+    pad(header.stringsOffset);
+    for (std::string_view text : strings) {
+        write(text.data(), text.size());
+    }
+
+    header.checksum = checksum.Finish();
+    ok &= fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok &= fclose(file) == 0;
+    if (!ok) {
+        std::cerr << "Write to " << path << " failed" << std::endl;
+        remove(path.c_str());
+    }
+    return ok;
+}
+
+// A snapshot mapped read-only. Lookups run straight against the mapping:
+// nothing is parsed and nothing is allocated per row.
+class BidSnapshot {
+
+private:
+    std::string path;
+    std::shared_ptr<MappedFile> file;
+    const SnapshotHeader* header = nullptr;
+    const SnapshotRow* rowArray = nullptr;
+    const uint32_t* byId = nullptr;
+    const char* strings = nullptr;
+
+    bool inBounds(uint64_t ref) const {
+        return (ref >> 24) + (ref & SNAPSHOT_MAX_STRING) <= header->stringBytes;
+    }
+
+    // An unverified file may hold bad references; they read as empty
+    std::string_view text(uint64_t ref) const {
+        if (!inBounds(ref)) {
+            return std::string_view();
+        }
+        return std::string_view(strings + (ref >> 24), (size_t)(ref & SNAPSHOT_MAX_STRING));
+    }
+
+    bool fail(const char* reason) {
+        std::cerr << path << ": " << reason << std::endl;
+        Close();
+        return false;
+    }
+
+public:
+    // Maps path and checks its header and section bounds, which is all a
+    // read-only lookup needs, in time independent of the file's size. With
+    // verify set (restores always do) it also runs Verify(), so a damaged
+    // file is refused up front. Bounds are checked by subtraction from the
+    // mapped size, so no crafted offset can wrap around and pass.
+    bool Open(const std::string& snapshotPath, bool verify = true) {
+        Close();
+        path = snapshotPath;
+        file = std::make_shared<MappedFile>();
+        if (!file->Open(path)) {
+            return fail("unable to open");
+        }
+        if (file->size() < sizeof(SnapshotHeader)) {
+            return fail("not a bid snapshot");
+        }
+        header = reinterpret_cast<const SnapshotHeader*>(file->begin());
+        if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+            return fail("not a bid snapshot");
+        }
+        if (header->version != SNAPSHOT_VERSION || header->headerBytes != sizeof(SnapshotHeader)) {
+            return fail("unsupported snapshot version");
+        }
+        uint64_t rows = header->rows;
+        uint64_t fileBytes = file->size();
+        if (header->fileBytes != fileBytes || rows > UINT32_MAX || header->rowsOffset != sizeof(SnapshotHeader) ||
+            header->byIdOffset % 8 != 0 || header->byIdOffset < header->rowsOffset || header->byIdOffset > fileBytes ||
+            rows * sizeof(SnapshotRow) > header->byIdOffset - header->rowsOffset ||
+            header->stringsOffset < header->byIdOffset || header->stringsOffset > fileBytes ||
+            rows * sizeof(uint32_t) > header->stringsOffset - header->byIdOffset ||
+            header->stringBytes != fileBytes - header->stringsOffset) {
+            return fail("snapshot layout is inconsistent");
+        }
+
+        rowArray = reinterpret_cast<const SnapshotRow*>(file->begin() + header->rowsOffset);
+        byId = reinterpret_cast<const uint32_t*>(file->begin() + header->byIdOffset);
+        strings = file->begin() + header->stringsOffset;
+        return !verify || Verify();
+    }
+
+    // Checksums the whole file and checks every row's references; closes
+    // the snapshot and returns false if any of it is off
+    bool Verify() {
+        if (header == nullptr) {
+            return false;
+        }
+        uint64_t rows = header->rows;
+        SnapshotHeader zeroed = *header;
+        zeroed.checksum = 0;
+        SnapshotChecksum checksum;
+        checksum.Add(&zeroed, sizeof(zeroed));
+        checksum.Add(file->begin() + sizeof(SnapshotHeader), file->size() - sizeof(SnapshotHeader));
+        if (checksum.Finish() != header->checksum) {
+            return fail("snapshot checksum mismatch");
+        }
+
+        for (uint64_t i = 0; i < rows; i++) {
+            const SnapshotRow& row = rowArray[i];
+            if (!inBounds(row.bidId) || !inBounds(row.title) || !inBounds(row.fund) || byId[i] >= rows) {
+                return fail("snapshot row out of bounds");
+            }
+        }
+        return true;
+    }
+
+    void Close() {
+        path.clear();
+        file.reset();
+        header = nullptr;
+        rowArray = nullptr;
+        byId = nullptr;
+        strings = nullptr;
+    }
+
+    bool IsOpen() const {
+        return header != nullptr;
+    }
+
+    size_t Size() const {
+        return header == nullptr ? 0 : (size_t)header->rows;
+    }
+
+    std::string Container() const {
+        return header == nullptr ? std::string() : std::string(header->container, strnlen(header->container, sizeof(header->container)));
+    }
+
+    std::string_view BidId(size_t i) const {
+        return text(rowArray[i].bidId);
+    }
+
+    std::string_view Title(size_t i) const {
+        return text(rowArray[i].title);
+    }
+
+    std::string_view Fund(size_t i) const {
+        return text(rowArray[i].fund);
+    }
+
+    double Amount(size_t i) const {
+        return rowArray[i].amount;
+    }
+
+    // Binary search of the id index; returns Size() when bidId is absent.
+    // Row numbers past the end, which only an unverified file can hold,
+    // compare as empty ids and never match.
+    size_t Search(std::string_view bidId) const {
+        size_t rows = Size();
+        auto idAt = [this, rows](uint32_t row) {
+            return row < rows ? BidId(row) : std::string_view();
+        };
+        const uint32_t* first = byId;
+        const uint32_t* last = byId + rows;
+        const uint32_t* found = std::lower_bound(first, last, bidId, [&idAt](uint32_t row, std::string_view key) {
+            return idAt(row) < key;
+        });
+        return found != last && *found < rows && BidId(*found) == bidId ? *found : rows;
+    }
+
+    // Appends every row to store without copying a string: the store
+    // points into the mapping and keeps it alive until it is cleared.
+    // rows gets the new RowIds in saved order, sortedRows the same rows
+    // ordered by bidId, ready for a tree's BulkLoad.
+    void AppendTo(BidStore& store, std::vector<RowId>& rows, std::vector<RowId>& sortedRows) const {
+        store.Retain(file);
+        rows.clear();
+        rows.reserve(Size());
+        for (size_t i = 0; i < Size(); i++) {
+            rows.push_back(store.AppendViews(BidId(i), Title(i), Fund(i), Amount(i)));
+        }
+        sortedRows.resize(Size());
+        for (size_t i = 0; i < Size(); i++) {
+            sortedRows[i] = rows[byId[i]];
+        }
+    }
+};
+
+inline void displayBid(const BidSnapshot& snapshot, size_t i) {
+    std::cout << snapshot.BidId(i) << ": " << snapshot.Title(i) << " | " << snapshot.Amount(i) << " | " << snapshot.Fund(i) << std::endl;
+}
+
+// Where a warm start spent its time, in seconds
+struct SnapshotTimings {
+    double openSeconds = 0.0;   // map, checksum and bounds checks
+    double attachSeconds = 0.0; // rows added to the store as views
+    double buildSeconds = 0.0;  // the container's index
+    size_t rows = 0;
+};
+
+inline void printSnapshotTimings(const SnapshotTimings& timings) {
+    std::cout << timings.rows << " bids restored from snapshot" << std::endl;
+    std::cout << "  open:   " << timings.openSeconds << " seconds" << std::endl;
+    std::cout << "  attach: " << timings.attachSeconds << " seconds" << std::endl;
+    std::cout << "  build:  " << timings.buildSeconds << " seconds" << std::endl;
+}
+
+// The menus' snapshot options share these prompts
+inline std::string promptSnapshotPath() {
+    std::string path;
+    std::cout << "Enter snapshot file: ";
+    std::cin >> path;
+    return path;
+}
+
+// The menus' Search Snapshot option: maps a snapshot and looks one id up
+// in place, loading nothing into the program's own container. Only the
+// header is checked, so this answers in milliseconds at any size.
+inline void searchSnapshotFromMenu() {
+    std::string path = promptSnapshotPath();
+    std::string bidKey;
+    std::cout << "Enter Id: ";
+    std::cin >> bidKey;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BidSnapshot snapshot;
+    if (!snapshot.Open(path, false)) {
+        return;
+    }
+    double openSeconds = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    size_t found = snapshot.Search(bidKey);
+    double searchSeconds = secondsSince(start);
+
+    if (found < snapshot.Size()) {
+        displayBid(snapshot, found);
+    }
+    else {
+        std::cout << "Bid Id " << bidKey << " not found." << std::endl;
+    }
+    std::cout << "  open:   " << openSeconds << " seconds" << std::endl;
+    std::cout << "  search: " << searchSeconds << " seconds" << std::endl;
+}
+
+// Restores a snapshot into store and hands its rows to build; returns
+// false (having printed why) if the file does not check out. replace runs
+// only once it has, so a caller that drops its bids there keeps them when
+// the path is wrong or the file is damaged.
+template <typename Replace, typename Build>
+bool loadSnapshot(const std::string& path, BidStore& store, Replace replace, Build build) {
+    SnapshotTimings timings;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BidSnapshot snapshot;
+    if (!snapshot.Open(path)) {
+        return false;
+    }
+    timings.openSeconds = secondsSince(start);
+    replace();
+
+    start = std::chrono::steady_clock::now();
+    std::vector<RowId> rows;
+    std::vector<RowId> sortedRows;
+    snapshot.AppendTo(store, rows, sortedRows);
+    timings.rows = rows.size();
+    timings.attachSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    build(rows, sortedRows);
+    timings.buildSeconds = secondsSince(start);
+
+    printSnapshotTimings(timings);
+    return true;
+}
+
+// Adds the snapshot's bids to whatever store already holds
+template <typename Build>
+bool loadSnapshot(const std::string& path, BidStore& store, Build build) {
+    return loadSnapshot(path, store, []() {}, build);
+}
+
+#endif // BIDSNAPSHOT_HPP
@@ -0,0 +1,42 @@
+//============================================================================
+// Name        : BidStats.cpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Counting replacements for the global operator new / delete
+//============================================================================
+
+// Global replacements may only be defined once per program, so they live
+// in this one translation unit rather than in BidStats.hpp. Link it into a
+// lab for heap counts in its Stats dump; without it the lab keeps the
+// standard allocator and reports the heap counters as disabled.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "BidStats.hpp"
+
+#if BID_STATS
+static const bool heapCountingLinked = (heapCounters.linked = true);
+
+void* operator new(std::size_t size) {
+    heapCounters.allocations.fetch_add(1, std::memory_order_relaxed);
+    heapCounters.bytes.fetch_add(size, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    if (memory != nullptr) {
+        heapCounters.deallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+#endif
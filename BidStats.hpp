@@ -0,0 +1,132 @@
+//============================================================================
+// Name        : BidStats.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Counters and histograms behind the containers' Stats dumps
+//============================================================================
+
+#ifndef BIDSTATS_HPP
+#define BIDSTATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+#include "NodePool.hpp"
+
+// Compile with -DBID_STATS=0 to drop the hot-path counters (per-search
+// probe and comparison counts, heap new/delete counts). Structural stats
+// such as chain lengths and tree height are computed on demand by the
+// Stats dump and are always available. Heap counts also need BidStats.cpp
+// linked in (g++ lab.cpp BidStats.cpp), which replaces operator new and
+// delete for the whole program.
+#ifndef BID_STATS
+#define BID_STATS 1
+#endif
+
+const bool STATS_ENABLED = BID_STATS != 0;
+
+// Power-of-two histogram: bucket 0 counts zeros, bucket i counts values
+// in [2^(i-1), 2^i)
+class Histogram {
+
+public:
+    static const int BUCKETS = 65;
+
+private:
+    uint64_t counts[BUCKETS] = {};
+    uint64_t samples = 0;
+    uint64_t total = 0;
+    uint64_t largest = 0;
+
+public:
+    void Record(uint64_t value) {
+        int bucket = 0;
+        while (bucket < 64 && (value >> bucket) != 0) {
+            bucket++;
+        }
+        counts[bucket]++;
+        samples++;
+        total += value;
+        if (value > largest) {
+            largest = value;
+        }
+    }
+
+    uint64_t Samples() const {
+        return samples;
+    }
+
+    double Mean() const {
+        return samples == 0 ? 0.0 : (double)total / (double)samples;
+    }
+
+    uint64_t Max() const {
+        return largest;
+    }
+
+    void Clear() {
+        *this = Histogram();
+    }
+
+    // Only non-empty buckets are written, each as its value range
+    void WriteJson(std::ostream& out) const {
+        out << "{\"samples\": " << samples << ", \"mean\": " << Mean() << ", \"max\": " << largest << ", \"buckets\": [";
+        bool first = true;
+        for (int i = 0; i < BUCKETS; i++) {
+            if (counts[i] == 0) {
+                continue;
+            }
+            uint64_t low = i == 0 ? 0 : 1ULL << (i - 1);
+            uint64_t high = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (1ULL << i) - 1);
+            out << (first ? "" : ", ") << "{\"min\": " << low << ", \"max\": " << high << ", \"count\": " << counts[i] << "}";
+            first = false;
+        }
+        out << "]}";
+    }
+};
+
+// What each Search cost: chain nodes, probe groups or key comparisons,
+// depending on the container. Compiled out with BID_STATS=0.
+struct SearchStats {
+    uint64_t searches = 0;
+    uint64_t hits = 0;
+    Histogram probes;
+
+    void Record(uint64_t probeCount, bool hit) {
+        if (STATS_ENABLED) {
+            searches++;
+            hits += hit ? 1 : 0;
+            probes.Record(probeCount);
+        }
+    }
+
+    void WriteJson(std::ostream& out) const {
+        out << "{\"enabled\": " << (STATS_ENABLED ? "true" : "false") << ", \"searches\": " << searches << ", \"hits\": " << hits << ", \"probes\": ";
+        probes.WriteJson(out);
+        out << "}";
+    }
+};
+
+// Every operator new / delete in the program, counted by the replacements
+// in BidStats.cpp. Relaxed atomics: the loaders and concurrent table
+// allocate from several threads, and only the totals matter.
+struct HeapCounters {
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> deallocations{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    bool linked = false; // set by BidStats.cpp when it is part of the program
+};
+
+inline HeapCounters heapCounters;
+
+inline void writeAllocationJson(std::ostream& out, const AllocationCounters& pool) {
+    out << "{\"pool\": {\"allocations\": " << pool.allocations << ", \"deallocations\": " << pool.deallocations
+        << ", \"live\": " << pool.liveNodes() << ", \"system_allocations\": " << pool.systemAllocations
+        << ", \"bytes_reserved\": " << pool.bytesReserved << "}, \"heap\": {\"enabled\": " << (STATS_ENABLED && heapCounters.linked ? "true" : "false")
+        << ", \"news\": " << heapCounters.allocations.load(std::memory_order_relaxed)
+        << ", \"deletes\": " << heapCounters.deallocations.load(std::memory_order_relaxed)
+        << ", \"bytes\": " << heapCounters.bytes.load(std::memory_order_relaxed) << "}}";
+}
+
+#endif // BIDSTATS_HPP
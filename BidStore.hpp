@@ -0,0 +1,297 @@
+//============================================================================
+// Name        : BidStore.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Columnar bid storage shared by every bid container
+//============================================================================
+
+#ifndef BIDSTORE_HPP
+#define BIDSTORE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// Asks for the cache line holding address ahead of a read; batched
+// searches issue these for the next step while other lookups proceed
+inline void prefetchRead(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+// define a structure to hold bid information
+struct Bid {
+    std::string bidId; // unique identifier
+    std::string title;
+    std::string fund;
+    double amount;
+
+    Bid() {
+        amount = 0.0;
+    }
+};
+
+// Containers refer to bids by their row in a BidStore
+typedef uint32_t RowId;
+const RowId NO_ROW = UINT32_MAX;
+
+// Append-only character storage. Strings are copied into large chunks
+// that never move, so the views it hands out stay valid until Clear().
+class StringArena {
+
+private:
+    static const size_t CHUNK_BYTES = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t used = CHUNK_BYTES;
+    size_t bytes = 0;
+
+public:
+    std::string_view Add(std::string_view text) {
+        if (text.empty()) {
+            return std::string_view();
+        }
+        if (used + text.size() > CHUNK_BYTES) {
+            // Oversized strings get a chunk of their own
+            size_t size = text.size() > CHUNK_BYTES ? text.size() : CHUNK_BYTES;
+            chunks.emplace_back(new char[size]);
+            bytes += size;
+            used = 0;
+        }
+        char* copy = chunks.back().get() + used;
+        memcpy(copy, text.data(), text.size());
+        used += text.size();
+        return std::string_view(copy, text.size());
+    }
+
+    void Clear() {
+        chunks.clear();
+        used = CHUNK_BYTES;
+        bytes = 0;
+    }
+
+    size_t Bytes() const {
+        return bytes;
+    }
+};
+
+// Column-oriented bid rows. Ids, titles and funds point into one string
+// arena (funds are interned, since a few names repeat on every row) and
+// amounts sit in their own array. Rows live in fixed-size blocks that are
+// never moved, so one thread may append while others read rows that were
+// already published.
+class BidStore {
+
+private:
+    static const uint32_t BLOCK_ROWS = 1 << 16;
+    static const uint32_t MAX_BLOCKS = 1 << 16;
+
+    struct StringRef {
+        const char* data;
+        uint32_t length;
+
+        std::string_view view() const {
+            return std::string_view(data, length);
+        }
+    };
+
+    struct Block {
+        StringRef ids[BLOCK_ROWS];
+        StringRef titles[BLOCK_ROWS];
+        StringRef funds[BLOCK_ROWS];
+        double amounts[BLOCK_ROWS];
+    };
+
+    std::unique_ptr<std::unique_ptr<Block>[]> blocks;
+    std::atomic<uint32_t> rows{ 0 };
+    std::mutex appendLock;
+    StringArena arena;
+    std::unordered_map<std::string_view, std::string_view> funds;
+    std::vector<std::shared_ptr<const void>> backings; // kept alive for AppendViews
+
+    static StringRef toRef(std::string_view text) {
+        return { text.data(), (uint32_t)text.size() };
+    }
+
+public:
+    BidStore() : blocks(new std::unique_ptr<Block>[MAX_BLOCKS]) {
+    }
+
+    BidStore(const BidStore&) = delete;
+    BidStore& operator=(const BidStore&) = delete;
+
+    // Safe to call from several threads, and while others read
+    RowId Append(std::string_view bidId, std::string_view title, std::string_view fund, double amount) {
+        std::lock_guard<std::mutex> lock(appendLock);
+        RowId row = rows.load(std::memory_order_relaxed);
+        if (row % BLOCK_ROWS == 0) {
+            blocks[row / BLOCK_ROWS].reset(new Block());
+        }
+
+        std::unordered_map<std::string_view, std::string_view>::iterator known = funds.find(fund);
+        if (known == funds.end()) {
+            std::string_view copy = arena.Add(fund);
+            known = funds.emplace(copy, copy).first;
+        }
+
+        Block& block = *blocks[row / BLOCK_ROWS];
+        uint32_t slot = row % BLOCK_ROWS;
+        block.ids[slot] = toRef(arena.Add(bidId));
+        block.titles[slot] = toRef(arena.Add(title));
+        block.funds[slot] = toRef(known->second);
+        block.amounts[slot] = amount;
+
+        // Release makes the row visible to readers only once it is written
+        rows.store(row + 1, std::memory_order_release);
+        return row;
+    }
+
+    RowId Append(const Bid& bid) {
+        return Append(bid.bidId, bid.title, bid.fund, bid.amount);
+    }
+
+    // Adds a row whose strings are not copied: the views must stay valid
+    // until Clear(), e.g. by pointing into memory handed to Retain().
+    // Snapshots load this way, so a warm start copies no strings.
+    RowId AppendViews(std::string_view bidId, std::string_view title, std::string_view fund, double amount) {
+        std::lock_guard<std::mutex> lock(appendLock);
+        RowId row = rows.load(std::memory_order_relaxed);
+        if (row % BLOCK_ROWS == 0) {
+            blocks[row / BLOCK_ROWS].reset(new Block());
+        }
+
+        Block& block = *blocks[row / BLOCK_ROWS];
+        uint32_t slot = row % BLOCK_ROWS;
+        block.ids[slot] = toRef(bidId);
+        block.titles[slot] = toRef(title);
+        block.funds[slot] = toRef(fund);
+        block.amounts[slot] = amount;
+
+        rows.store(row + 1, std::memory_order_release);
+        return row;
+    }
+
+    // Keeps backing (a mapped file, say) alive until Clear()
+    void Retain(std::shared_ptr<const void> backing) {
+        std::lock_guard<std::mutex> lock(appendLock);
+        backings.push_back(std::move(backing));
+    }
+
+    std::string_view BidId(RowId row) const {
+        return blocks[row / BLOCK_ROWS]->ids[row % BLOCK_ROWS].view();
+    }
+
+    std::string_view Title(RowId row) const {
+        return blocks[row / BLOCK_ROWS]->titles[row % BLOCK_ROWS].view();
+    }
+
+    std::string_view Fund(RowId row) const {
+        return blocks[row / BLOCK_ROWS]->funds[row % BLOCK_ROWS].view();
+    }
+
+    double Amount(RowId row) const {
+        return blocks[row / BLOCK_ROWS]->amounts[row % BLOCK_ROWS];
+    }
+
+    // Starts loading the id column entry for row; its characters are a
+    // second miss, prefetched once BidId(row) can be read
+    void PrefetchBidId(RowId row) const {
+        prefetchRead(&blocks[row / BLOCK_ROWS]->ids[row % BLOCK_ROWS]);
+    }
+
+    // Copies a row back out into a standalone Bid
+    Bid Get(RowId row) const {
+        Bid bid;
+        bid.bidId = std::string(BidId(row));
+        bid.title = std::string(Title(row));
+        bid.fund = std::string(Fund(row));
+        bid.amount = Amount(row);
+        return bid;
+    }
+
+    size_t Size() const {
+        return rows.load(std::memory_order_acquire);
+    }
+
+    // Approximate bytes held: row blocks plus string chunks
+    size_t MemoryBytes() const {
+        size_t blockCount = (Size() + BLOCK_ROWS - 1) / BLOCK_ROWS;
+        return blockCount * sizeof(Block) + arena.Bytes();
+    }
+
+    // Not thread-safe; every RowId and view handed out becomes invalid
+    void Clear() {
+        std::lock_guard<std::mutex> lock(appendLock);
+        uint32_t blockCount = (rows.load() + BLOCK_ROWS - 1) / BLOCK_ROWS;
+        for (uint32_t i = 0; i < blockCount; i++) {
+            blocks[i].reset();
+        }
+        rows.store(0);
+        funds.clear();
+        arena.Clear();
+        backings.clear();
+    }
+};
+
+// Lightweight handle to one row of a BidStore. An empty handle (no store)
+// is what searches return when nothing matches.
+struct BidRef {
+    const BidStore* store;
+    RowId row;
+
+    BidRef() {
+        store = nullptr;
+        row = NO_ROW;
+    }
+
+    BidRef(const BidStore* aStore, RowId aRow) {
+        store = aStore;
+        row = aRow;
+    }
+
+    bool valid() const {
+        return store != nullptr && row != NO_ROW;
+    }
+
+    std::string_view bidId() const {
+        return store->BidId(row);
+    }
+
+    std::string_view title() const {
+        return store->Title(row);
+    }
+
+    std::string_view fund() const {
+        return store->Fund(row);
+    }
+
+    double amount() const {
+        return store->Amount(row);
+    }
+};
+
+inline void displayBid(BidRef bid) {
+    std::cout << bid.bidId() << ": " << bid.title() << " | " << bid.amount() << " | " << bid.fund() << std::endl;
+}
+
+inline void displayBid(const Bid& bid) {
+    std::cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | " << bid.fund << std::endl;
+}
+
+#endif // BIDSTORE_HPP
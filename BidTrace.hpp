@@ -0,0 +1,403 @@
+//============================================================================
+// Name        : BidTrace.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Binary workload traces: record, generate and replay
+//============================================================================
+
+#ifndef BIDTRACE_HPP
+#define BIDTRACE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BidStore.hpp"
+#include "MappedCsv.hpp"
+
+// A trace file is the 8-byte magic followed by one record per operation:
+// an op byte, then for inserts the id, title and fund (each a LEB128
+// length and the bytes) and the amount as 8 raw bytes; for searches and
+// removes just the id; for prints nothing.
+const char TRACE_MAGIC[8] = { 'B', 'I', 'D', 'T', 'R', 'C', '0', '1' };
+
+enum TraceOp : uint8_t {
+    TRACE_INSERT = 1,
+    TRACE_SEARCH = 2,
+    TRACE_REMOVE = 3,
+    TRACE_PRINT = 4
+};
+
+struct TraceEvent {
+    TraceOp op;
+    Bid bid; // only bidId is set for searches and removes
+};
+
+// Appends operations to a trace file through a 1 MB stdio buffer
+class TraceWriter {
+
+private:
+    FILE* file = nullptr;
+
+    void writeLength(size_t length) {
+        do {
+            uint8_t byte = (uint8_t)(length & 0x7F);
+            length >>= 7;
+            fputc(length > 0 ? (byte | 0x80) : byte, file);
+        } while (length > 0);
+    }
+
+    void writeString(std::string_view text) {
+        writeLength(text.size());
+        fwrite(text.data(), 1, text.size(), file);
+    }
+
+public:
+    TraceWriter() = default;
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    virtual ~TraceWriter() {
+        Close();
+    }
+
+    bool Open(const std::string& path) {
+        Close();
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), file);
+        return true;
+    }
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    void Close() {
+        if (file != nullptr) {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    void Insert(std::string_view bidId, std::string_view title, std::string_view fund, double amount) {
+        if (file == nullptr) {
+            return;
+        }
+        fputc(TRACE_INSERT, file);
+        writeString(bidId);
+        writeString(title);
+        writeString(fund);
+        fwrite(&amount, sizeof(amount), 1, file);
+    }
+
+    void Insert(BidRef bid) {
+        Insert(bid.bidId(), bid.title(), bid.fund(), bid.amount());
+    }
+
+    void Search(std::string_view bidId) {
+        if (file != nullptr) {
+            fputc(TRACE_SEARCH, file);
+            writeString(bidId);
+        }
+    }
+
+    void Remove(std::string_view bidId) {
+        if (file != nullptr) {
+            fputc(TRACE_REMOVE, file);
+            writeString(bidId);
+        }
+    }
+
+    void Print() {
+        if (file != nullptr) {
+            fputc(TRACE_PRINT, file);
+        }
+    }
+};
+
+// Starts recording to the file named by the BID_TRACE environment
+// variable, if it is set; every menu records through one of these
+inline void openTraceFromEnvironment(TraceWriter& trace) {
+    const char* path = getenv("BID_TRACE");
+    if (path != nullptr && *path != '\0') {
+        if (trace.Open(path)) {
+            std::cout << "Recording operations to " << path << std::endl;
+        }
+        else {
+            std::cerr << "Unable to create trace " << path << std::endl;
+        }
+    }
+}
+
+// Decodes a whole trace up front, so replay measures only the container
+inline bool readTrace(const std::string& path, std::vector<TraceEvent>& events) {
+    MappedFile file;
+    if (!file.Open(path) || file.size() < sizeof(TRACE_MAGIC) || memcmp(file.begin(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        std::cerr << path << " is not a bid trace" << std::endl;
+        return false;
+    }
+
+    const char* pos = file.begin() + sizeof(TRACE_MAGIC);
+    const char* end = file.end();
+    bool ok = true;
+    auto readString = [&](std::string& text) {
+        size_t length = 0;
+        for (unsigned shift = 0; ok; shift += 7) {
+            if (pos == end || shift > 63) {
+                ok = false;
+                break;
+            }
+            uint8_t byte = (uint8_t)*pos++;
+            length |= (size_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        if (!ok || (size_t)(end - pos) < length) {
+            ok = false;
+            return;
+        }
+        text.assign(pos, length);
+        pos += length;
+    };
+
+    events.clear();
+    while (ok && pos < end) {
+        TraceEvent event;
+        event.op = (TraceOp)*pos++;
+        switch (event.op) {
+        case TRACE_INSERT:
+            readString(event.bid.bidId);
+            readString(event.bid.title);
+            readString(event.bid.fund);
+            if (ok && (size_t)(end - pos) >= sizeof(double)) {
+                memcpy(&event.bid.amount, pos, sizeof(double));
+                pos += sizeof(double);
+            }
+            else {
+                ok = false;
+            }
+            break;
+        case TRACE_SEARCH:
+        case TRACE_REMOVE:
+            readString(event.bid.bidId);
+            break;
+        case TRACE_PRINT:
+            break;
+        default:
+            ok = false;
+        }
+        if (ok) {
+            events.push_back(std::move(event));
+        }
+    }
+    if (!ok) {
+        std::cerr << path << " is truncated or corrupt after " << events.size() << " operations" << std::endl;
+    }
+    return ok;
+}
+
+// Discards everything written to it; replays print into one of these
+class NullStreamBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+};
+
+struct ReplayStats {
+    size_t inserts = 0;
+    size_t searches = 0;
+    size_t hits = 0;
+    size_t removes = 0;
+    size_t prints = 0;
+    double seconds = 0;
+
+    size_t operations() const {
+        return inserts + searches + removes + prints;
+    }
+};
+
+// Runs every event against the container as fast as it will go. Any
+// container with Insert(Bid), Search(string) and Remove(string) works;
+// print is whatever walk prints it (PrintAll, InOrder, ...), and its
+// output is thrown away while the trace runs.
+template <typename Container, typename Print>
+ReplayStats replayTrace(const std::vector<TraceEvent>& events, Container& container, Print print) {
+    ReplayStats stats;
+    NullStreamBuffer sink;
+    std::streambuf* console = std::cout.rdbuf(&sink);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const TraceEvent& event : events) {
+        switch (event.op) {
+        case TRACE_INSERT:
+            container.Insert(event.bid);
+            stats.inserts++;
+            break;
+        case TRACE_SEARCH:
+            stats.hits += container.Search(event.bid.bidId).valid();
+            stats.searches++;
+            break;
+        case TRACE_REMOVE:
+            container.Remove(event.bid.bidId);
+            stats.removes++;
+            break;
+        case TRACE_PRINT:
+            print(container);
+            stats.prints++;
+            break;
+        }
+    }
+    stats.seconds = secondsSince(start);
+    std::cout.rdbuf(console);
+    return stats;
+}
+
+inline void printReplayStats(const ReplayStats& stats) {
+    std::cout << stats.operations() << " operations replayed in " << stats.seconds << " seconds";
+    if (stats.seconds > 0) {
+        std::cout << " (" << (uint64_t)(stats.operations() / stats.seconds) << " ops/sec)";
+    }
+    std::cout << std::endl;
+    std::cout << "  inserts:  " << stats.inserts << std::endl;
+    std::cout << "  searches: " << stats.searches << " (" << stats.hits << " hits)" << std::endl;
+    std::cout << "  removes:  " << stats.removes << std::endl;
+    std::cout << "  prints:   " << stats.prints << std::endl;
+}
+
+//============================================================================
+// Synthetic traces
+//============================================================================
+
+enum InsertOrder {
+    SHUFFLED_ORDER,
+    SORTED_ORDER,
+    REVERSE_ORDER
+};
+
+struct TraceOptions {
+    size_t keys = 100000;        // bids inserted before the mixed phase
+    size_t operations = 1000000; // mixed operations after that
+    double skew = 0.99;          // Zipf exponent; 0 picks keys uniformly
+    InsertOrder order = SHUFFLED_ORDER;
+    int searchPercent = 90;
+    int removePercent = 5;       // the rest re-insert removed bids
+    size_t printEvery = 0;       // a print every this many operations, 0 for none
+    uint64_t seed = 42;
+};
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^skew
+// by binary search over the cumulative weights
+class ZipfianGenerator {
+
+private:
+    std::vector<double> cumulative;
+    std::uniform_real_distribution<double> uniform;
+
+public:
+    ZipfianGenerator(size_t n, double skew) : cumulative(std::max<size_t>(1, n)), uniform(0.0, 1.0) {
+        double total = 0;
+        for (size_t rank = 0; rank < cumulative.size(); rank++) {
+            total += 1.0 / pow((double)(rank + 1), skew);
+            cumulative[rank] = total;
+        }
+        for (double& weight : cumulative) {
+            weight /= total;
+        }
+    }
+
+    template <typename Random>
+    size_t operator()(Random& rng) {
+        double target = uniform(rng);
+        size_t rank = (size_t)(std::lower_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin());
+        return std::min(rank, cumulative.size() - 1);
+    }
+};
+
+// Ids are fixed-width, so sorted insert order is sorted by string too.
+// Key popularity is shuffled, so the hot keys are spread over the id range
+// rather than clustered at one end of a tree.
+inline bool generateTrace(const std::string& path, const TraceOptions& options) {
+    TraceWriter trace;
+    if (!trace.Open(path)) {
+        std::cerr << "Unable to create trace " << path << std::endl;
+        return false;
+    }
+
+    std::mt19937_64 rng(options.seed);
+    std::uniform_real_distribution<double> amounts(1.0, 10000.0);
+    auto makeId = [](size_t key) {
+        return std::to_string(10000000 + key);
+    };
+    auto insert = [&](size_t key) {
+        std::string bidId = makeId(key);
+        trace.Insert(bidId, "Bid " + bidId, "General Fund", (double)(int64_t)(amounts(rng) * 100) / 100.0);
+    };
+
+    std::vector<size_t> order(options.keys);
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    if (options.order == REVERSE_ORDER) {
+        std::reverse(order.begin(), order.end());
+    }
+    else if (options.order == SHUFFLED_ORDER) {
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+    for (size_t key : order) {
+        insert(key);
+    }
+
+    // Rank -> key, so popularity does not follow id order
+    std::shuffle(order.begin(), order.end(), rng);
+    ZipfianGenerator popularity(options.keys, options.skew);
+    // A key is removed only while present and re-inserted only once, so a
+    // replay never holds two bids with one id, whatever the engine
+    std::vector<bool> present(options.keys, true);
+    std::vector<size_t> removed;
+    for (size_t i = 0; i < options.operations && options.keys > 0; i++) {
+        if (options.printEvery > 0 && i % options.printEvery == options.printEvery - 1) {
+            trace.Print();
+            continue;
+        }
+        int roll = (int)(rng() % 100);
+        size_t key = order[popularity(rng)];
+        if (roll < options.searchPercent) {
+            trace.Search(makeId(key));
+        }
+        else if (roll < options.searchPercent + options.removePercent && present[key]) {
+            trace.Remove(makeId(key));
+            present[key] = false;
+            removed.push_back(key);
+        }
+        else if (roll >= options.searchPercent + options.removePercent && !removed.empty()) {
+            insert(removed.back());
+            present[removed.back()] = true;
+            removed.pop_back();
+        }
+        else {
+            trace.Search(makeId(key));
+        }
+    }
+    trace.Close();
+    return true;
+}
+
+#endif // BIDTRACE_HPP
@@ -9,8 +9,20 @@
 #include <iostream>
 #include <time.h>
 #include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
-#include "CSVparser.hpp"
+#include "BidExport.hpp"
+#include "BidIndex.hpp"
+#include "BidSnapshot.hpp"
+#include "BidStats.hpp"
+#include "BidStore.hpp"
+#include "BidTrace.hpp"
+#include "MappedCsv.hpp"
+#include "NodePool.hpp"
 
 using namespace std;
 
@@ -18,113 +30,381 @@ using namespace std;
 // Global definitions visible to all methods and classes
 //============================================================================
 
-// forward declarations
-double strToDouble(string str, char ch);
+// Bid, BidStore and displayBid come from BidStore.hpp
 
-// define a structure to hold bid information
-struct Bid {
-    string bidId; // unique identifier
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
-    }
-};
+// forward declarations
+void sortRowsByBidId(const BidStore* store, vector<RowId>& rows);
+void keepLastRowPerBidId(const BidStore* store, vector<RowId>& rows);
 
 // Internal structure for tree node
 struct Node {
-    Bid bid;
+    RowId row;
     Node* left;
     Node* right;
 
     Node() {
+        row = NO_ROW;
         left = nullptr;
         right = nullptr;
     }
 
-    Node(Bid aBid) : Node() {
-        bid = aBid;
+    Node(RowId aRow) : Node() {
+        row = aRow;
     }
 };
 
+// Node count, height and how many nodes sit at each depth (root = 1),
+// walked with an explicit stack so a degenerate tree cannot overflow it
+template <typename TreeNode>
+void writeTreeShapeJson(ostream& out, const TreeNode* root) {
+    Histogram depths;
+    size_t nodes = 0;
+    size_t height = 0;
+    vector<pair<const TreeNode*, size_t>> stack;
+    if (root != nullptr) {
+        stack.emplace_back(root, 1);
+    }
+    while (!stack.empty()) {
+        const TreeNode* node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+        nodes++;
+        height = max(height, depth);
+        depths.Record(depth);
+        if (node->left != nullptr) {
+            stack.emplace_back(node->left, depth + 1);
+        }
+        if (node->right != nullptr) {
+            stack.emplace_back(node->right, depth + 1);
+        }
+    }
+
+    out << "\"nodes\": " << nodes << ", \"height\": " << height << ", \"node_depth\": ";
+    depths.WriteJson(out);
+}
+
+// Traversals shared by both binary trees. visit gets each node in turn;
+// an explicit stack keeps a degenerate tree from overflowing the call stack.
+template <typename TreeNode, typename Visit>
+void forEachInOrder(TreeNode* root, Visit visit) {
+    vector<TreeNode*> stack;
+    TreeNode* current = root;
+
+    while (current != nullptr || !stack.empty()) {
+        while (current != nullptr) {
+            stack.push_back(current);
+            current = current->left;
+        }
+        current = stack.back();
+        stack.pop_back();
+        visit(current);
+        current = current->right;
+    }
+}
+
+template <typename TreeNode, typename Visit>
+void forEachPostOrder(TreeNode* root, Visit visit) {
+    vector<TreeNode*> stack;
+    TreeNode* current = root;
+    TreeNode* lastVisited = nullptr;
+
+    while (current != nullptr || !stack.empty()) {
+        while (current != nullptr) {
+            stack.push_back(current);
+            current = current->left;
+        }
+        TreeNode* top = stack.back();
+        if (top->right != nullptr && top->right != lastVisited) {
+            current = top->right;
+        }
+        else {
+            visit(top);
+            lastVisited = top;
+            stack.pop_back();
+        }
+    }
+}
+
+template <typename TreeNode, typename Visit>
+void forEachPreOrder(TreeNode* root, Visit visit) {
+    vector<TreeNode*> stack;
+    if (root != nullptr) {
+        stack.push_back(root);
+    }
+
+    while (!stack.empty()) {
+        TreeNode* node = stack.back();
+        stack.pop_back();
+        visit(node);
+        if (node->right != nullptr) {
+            stack.push_back(node->right);
+        }
+        if (node->left != nullptr) {
+            stack.push_back(node->left);
+        }
+    }
+}
+
+const size_t BATCH_LANES = 16; // lookups in flight at once in SearchBatch
+
+// Descends for up to BATCH_LANES keys at once (asynchronous memory access
+// chaining). Each level is three dependent reads, the node, its row's id
+// column entry and the id's characters; a lane prefetches the next one and
+// yields to the other lanes, so their misses overlap instead of queueing.
+template <typename TreeNode>
+void searchTreeBatch(const BidStore* store, TreeNode* root, const vector<string_view>& keys, vector<BidRef>& results, SearchStats& stats) {
+    enum Stage { NODE, ROW, KEY, DONE };
+    struct Lane {
+        Stage stage;
+        size_t index;
+        TreeNode* node;
+        string_view id;
+        size_t comparisons;
+    };
+
+    results.assign(keys.size(), BidRef());
+    Lane lanes[BATCH_LANES];
+    size_t next = 0;
+    size_t active = 0;
+    auto visit = [&](Lane& lane, TreeNode* node) {
+        lane.node = node;
+        lane.stage = NODE;
+        prefetchRead(node);
+    };
+    auto start = [&](Lane& lane) {
+        // An empty tree answers every key as a miss right away
+        while (next < keys.size() && root == nullptr) {
+            stats.Record(0, false);
+            next++;
+        }
+        if (next == keys.size()) {
+            lane.stage = DONE;
+            return;
+        }
+        lane.index = next++;
+        lane.comparisons = 0;
+        visit(lane, root);
+        active++;
+    };
+    auto finish = [&](Lane& lane, bool hit) {
+        stats.Record(lane.comparisons, hit);
+        active--;
+        start(lane);
+    };
+
+    for (Lane& lane : lanes) {
+        start(lane);
+    }
+    while (active > 0) {
+        for (Lane& lane : lanes) {
+            switch (lane.stage) {
+            case NODE:
+                store->PrefetchBidId(lane.node->row);
+                lane.stage = ROW;
+                break;
+            case ROW:
+                lane.id = store->BidId(lane.node->row);
+                prefetchRead(lane.id.data());
+                lane.stage = KEY;
+                break;
+            case KEY: {
+                lane.comparisons++;
+                string_view bidId = keys[lane.index];
+                if (bidId == lane.id) {
+                    results[lane.index] = BidRef(store, lane.node->row);
+                    finish(lane, true);
+                    break;
+                }
+                TreeNode* child = bidId < lane.id ? lane.node->left : lane.node->right;
+                if (child == nullptr) {
+                    finish(lane, false);
+                }
+                else {
+                    visit(lane, child);
+                }
+                break;
+            }
+            case DONE:
+                break;
+            }
+        }
+    }
+}
+
 //============================================================================
 // Binary Search Tree class definition
 //============================================================================
 
+template <template <typename> class Allocator = NodePool>
 class BinarySearchTree {
 
 private:
     Node* root;
+    BidStore* store;
+    Allocator<Node> pool;
+    SearchStats searchStats; // nodes compared per Search
+    BidSecondaryIndex secondary; // fund and amount lookups over the same rows
 
-    void addNode(Node* node, Bid bid);
-    void inOrder(Node* node);
-    void postOrder(Node* node);
-    void preOrder(Node* node);
-    Node* removeNode(Node* node, string bidId);
+    string_view key(const Node* node) const;
+    void addNode(Node* node, RowId row);
+    Node* removeNode(Node* node, string_view bidId, RowId* removed);
     void deleteTree(Node* node);
 
 public:
-    BinarySearchTree();
+    BinarySearchTree(BidStore* bidStore);
     virtual ~BinarySearchTree();
     void InOrder();
     void PostOrder();
     void PreOrder();
-    void Insert(Bid bid);
+    template <typename Visit>
+    void ForEach(Visit visit);
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
     void Remove(string bidId);
-    Bid Search(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    BidSecondaryIndex::FundRange SearchFund(string_view fund) const;
+    BidSecondaryIndex::AmountRange SearchAmount(double low, double high) const;
+    void BulkLoad(vector<RowId>& rows);
+    void Clear();
+    const AllocationCounters& Allocations() const;
+    void PrintStats(ostream& out) const;
 };
 
-BinarySearchTree::BinarySearchTree() {
+template <template <typename> class Allocator>
+BinarySearchTree<Allocator>::BinarySearchTree(BidStore* bidStore) : secondary(bidStore) {
     root = nullptr;
+    store = bidStore;
+}
+
+template <template <typename> class Allocator>
+string_view BinarySearchTree<Allocator>::key(const Node* node) const {
+    return store->BidId(node->row);
+}
+
+template <template <typename> class Allocator>
+BinarySearchTree<Allocator>::~BinarySearchTree() {
+    Clear();
+}
+
+// A pooled allocator frees every node at once; otherwise walk the tree
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::Clear() {
+    if (!Allocator<Node>::BULK_RELEASE) {
+        deleteTree(root);
+    }
+    pool.Release();
+    secondary.Clear();
+    root = nullptr;
+}
+
+template <template <typename> class Allocator>
+const AllocationCounters& BinarySearchTree<Allocator>::Allocations() const {
+    return pool.Counters();
 }
 
-BinarySearchTree::~BinarySearchTree() {
-    deleteTree(root);
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::PrintStats(ostream& out) const {
+    out << "{\"container\": \"bst\", ";
+    writeTreeShapeJson(out, root);
+    out << ", \"search\": ";
+    searchStats.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, pool.Counters());
+    out << "}" << endl;
 }
 
-void BinarySearchTree::deleteTree(Node* node) {
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::deleteTree(Node* node) {
     if (node != nullptr) {
         deleteTree(node->left);
         deleteTree(node->right);
-        delete node;
+        pool.Destroy(node);
     }
 }
 
-void BinarySearchTree::InOrder() {
-    inOrder(root);
+// The three displays go through one buffered exporter on cout rather
+// than a flushed displayBid per bid
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::InOrder() {
+    BidExporter out(cout);
+    forEachInOrder(root, [&](Node* node) { out.Write(BidRef(store, node->row)); });
 }
 
-void BinarySearchTree::PostOrder() {
-    postOrder(root);
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::PostOrder() {
+    BidExporter out(cout);
+    forEachPostOrder(root, [&](Node* node) { out.Write(BidRef(store, node->row)); });
 }
 
-void BinarySearchTree::PreOrder() {
-    preOrder(root);
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::PreOrder() {
+    BidExporter out(cout);
+    forEachPreOrder(root, [&](Node* node) { out.Write(BidRef(store, node->row)); });
 }
 
-void BinarySearchTree::Insert(Bid bid) {
+// Every bid in id order
+template <template <typename> class Allocator>
+template <typename Visit>
+void BinarySearchTree<Allocator>::ForEach(Visit visit) {
+    forEachInOrder(root, [&](Node* node) { visit(BidRef(store, node->row)); });
+}
+
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+// An existing bid with the same id is replaced, as in every container
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::InsertRow(RowId row) {
     if (root == nullptr) {
-        root = new Node(bid);
+        root = pool.Create(row);
     }
     else {
-        addNode(root, bid);
+        addNode(root, row);
+    }
+    secondary.Add(row);
+}
+
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::Remove(string bidId) {
+    RowId removed = NO_ROW;
+    root = removeNode(root, bidId, &removed);
+    if (removed != NO_ROW) {
+        secondary.Remove(removed);
     }
 }
 
-void BinarySearchTree::Remove(string bidId) {
-    root = removeNode(root, bidId);
+template <template <typename> class Allocator>
+BidSecondaryIndex::FundRange BinarySearchTree<Allocator>::SearchFund(string_view fund) const {
+    return secondary.Fund(fund);
 }
 
-Bid BinarySearchTree::Search(string bidId) {
+template <template <typename> class Allocator>
+BidSecondaryIndex::AmountRange BinarySearchTree<Allocator>::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high);
+}
+
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    searchTreeBatch(store, root, keys, results, searchStats);
+}
+
+template <template <typename> class Allocator>
+BidRef BinarySearchTree<Allocator>::Search(string bidId) {
     Node* current = root;
+    size_t comparisons = 0;
 
     while (current != nullptr) {
-        if (current->bid.bidId == bidId) {
-            return current->bid;
+        comparisons++;
+        string_view currentId = key(current);
+        if (currentId == bidId) {
+            searchStats.Record(comparisons, true);
+            return BidRef(store, current->row);
         }
 
-        if (bidId < current->bid.bidId) {
+        if (bidId < currentId) {
             current = current->left;
         }
         else {
@@ -132,77 +412,105 @@ Bid BinarySearchTree::Search(string bidId) {
         }
     }
 
-    Bid bid;
+    searchStats.Record(comparisons, false);
+    BidRef bid;
     return bid;
 }
 
-void BinarySearchTree::addNode(Node* node, Bid bid) {
-    if (bid.bidId < node->bid.bidId) {
+// Builds a balanced tree straight from the loaded rows by sorting them
+// and linking each range's middle bid as its subtree root. When an id
+// repeats, the last row wins, as with Insert. A tree that already holds
+// bids gets them inserted one at a time instead.
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::BulkLoad(vector<RowId>& rows) {
+    if (root != nullptr) {
+        for (RowId row : rows) {
+            InsertRow(row);
+        }
+        rows.clear();
+        return;
+    }
+
+    sortRowsByBidId(store, rows);
+    keepLastRowPerBidId(store, rows);
+
+    struct Range {
+        size_t low;
+        size_t high;
+        Node** link;
+    };
+    vector<Range> stack;
+    stack.push_back({ 0, rows.size(), &root });
+    while (!stack.empty()) {
+        Range range = stack.back();
+        stack.pop_back();
+        if (range.low >= range.high) {
+            continue;
+        }
+        size_t mid = range.low + (range.high - range.low) / 2;
+        Node* node = pool.Create(rows[mid]);
+        *range.link = node;
+        stack.push_back({ range.low, mid, &node->left });
+        stack.push_back({ mid + 1, range.high, &node->right });
+    }
+    secondary.AddRows(rows);
+    rows.clear();
+}
+
+template <template <typename> class Allocator>
+void BinarySearchTree<Allocator>::addNode(Node* node, RowId row) {
+    if (store->BidId(row) < key(node)) {
         if (node->left == nullptr) {
-            node->left = new Node(bid);
+            node->left = pool.Create(row);
         }
         else {
-            addNode(node->left, bid);
+            addNode(node->left, row);
         }
     }
+    else if (store->BidId(row) == key(node)) {
+        secondary.Remove(node->row);
+        node->row = row;
+    }
     else {
         if (node->right == nullptr) {
-            node->right = new Node(bid);
+            node->right = pool.Create(row);
         }
         else {
-            addNode(node->right, bid);
+            addNode(node->right, row);
         }
     }
 }
 
-void BinarySearchTree::inOrder(Node* node) {
-    if (node != nullptr) {
-        inOrder(node->left);
-        displayBid(node->bid);
-        inOrder(node->right);
-    }
-}
-
-void BinarySearchTree::postOrder(Node* node) {
-    if (node != nullptr) {
-        postOrder(node->left);
-        postOrder(node->right);
-        displayBid(node->bid);
-    }
-}
-
-void BinarySearchTree::preOrder(Node* node) {
-    if (node != nullptr) {
-        displayBid(node->bid);
-        preOrder(node->left);
-        preOrder(node->right);
-    }
-}
-
-Node* BinarySearchTree::removeNode(Node* node, string bidId) {
+// removed gets the row that left the tree; the successor's row only
+// moves up, so unlinking it passes nullptr
+template <template <typename> class Allocator>
+Node* BinarySearchTree<Allocator>::removeNode(Node* node, string_view bidId, RowId* removed) {
     if (node == nullptr) {
         return node;
     }
 
-    if (bidId < node->bid.bidId) {
-        node->left = removeNode(node->left, bidId);
+    if (bidId < key(node)) {
+        node->left = removeNode(node->left, bidId, removed);
     }
-    else if (bidId > node->bid.bidId) {
-        node->right = removeNode(node->right, bidId);
+    else if (bidId > key(node)) {
+        node->right = removeNode(node->right, bidId, removed);
     }
     else {
+        if (removed != nullptr) {
+            *removed = node->row;
+        }
         if (node->left == nullptr && node->right == nullptr) {
-            delete node;
+            pool.Destroy(node);
             return nullptr;
         }
         else if (node->left == nullptr) {
             Node* temp = node->right;
-            delete node;
+            pool.Destroy(node);
             return temp;
         }
         else if (node->right == nullptr) {
             Node* temp = node->left;
-            delete node;
+            pool.Destroy(node);
             return temp;
         }
         else {
@@ -211,8 +519,8 @@ Node* BinarySearchTree::removeNode(Node* node, string bidId) {
                 temp = temp->left;
             }
 
-            node->bid = temp->bid;
-            node->right = removeNode(node->right, temp->bid.bidId);
+            node->row = temp->row;
+            node->right = removeNode(node->right, key(temp), nullptr);
         }
     }
 
@@ -220,95 +528,1077 @@ Node* BinarySearchTree::removeNode(Node* node, string bidId) {
 }
 
 //============================================================================
-// Static methods used for testing
+// Balanced (AVL) Binary Search Tree class definition
 //============================================================================
 
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | " << bid.fund << endl;
+// Internal structure for balanced tree node
+struct AvlNode {
+    RowId row;
+    AvlNode* left;
+    AvlNode* right;
+    int height;
+
+    AvlNode() {
+        row = NO_ROW;
+        left = nullptr;
+        right = nullptr;
+        height = 1;
+    }
+
+    AvlNode(RowId aRow) : AvlNode() {
+        row = aRow;
+    }
+};
+
+// Same interface as BinarySearchTree, but every insert and remove
+// rebalances on the way back up, so depth stays O(log n) even when bids
+// arrive sorted. Nothing recurses: updates keep the path in a fixed array
+// and traversals use an explicit stack.
+template <template <typename> class Allocator = NodePool>
+class BalancedBinarySearchTree {
+
+private:
+    // An AVL tree of height 64 would need more nodes than fit in memory
+    static const int MAX_DEPTH = 64;
+
+    AvlNode* root;
+    BidStore* store;
+    Allocator<AvlNode> pool;
+    SearchStats searchStats; // nodes compared per Search
+    BidSecondaryIndex secondary; // fund and amount lookups over the same rows
+
+    string_view key(const AvlNode* node) const;
+
+    static int height(AvlNode* node);
+    static void updateHeight(AvlNode* node);
+    static AvlNode* rotateLeft(AvlNode* node);
+    static AvlNode* rotateRight(AvlNode* node);
+    static AvlNode* rebalance(AvlNode* node);
+    void retrace(AvlNode** path[], int depth);
+
+public:
+    BalancedBinarySearchTree(BidStore* bidStore);
+    virtual ~BalancedBinarySearchTree();
+    void InOrder();
+    void PostOrder();
+    void PreOrder();
+    template <typename Visit>
+    void ForEach(Visit visit);
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
+    void Remove(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    BidSecondaryIndex::FundRange SearchFund(string_view fund) const;
+    BidSecondaryIndex::AmountRange SearchAmount(double low, double high) const;
+    void BulkLoad(vector<RowId>& rows);
+    void Clear();
+    const AllocationCounters& Allocations() const;
+    void PrintStats(ostream& out) const;
+};
+
+template <template <typename> class Allocator>
+BalancedBinarySearchTree<Allocator>::BalancedBinarySearchTree(BidStore* bidStore) : secondary(bidStore) {
+    root = nullptr;
+    store = bidStore;
 }
 
-void loadBids(string csvPath, BinarySearchTree* bst) {
-    cout << "Loading CSV file " << csvPath << endl;
+template <template <typename> class Allocator>
+string_view BalancedBinarySearchTree<Allocator>::key(const AvlNode* node) const {
+    return store->BidId(node->row);
+}
 
-    csv::Parser file = csv::Parser(csvPath);
+template <template <typename> class Allocator>
+BalancedBinarySearchTree<Allocator>::~BalancedBinarySearchTree() {
+    Clear();
+}
 
-    vector<string> header = file.getHeader();
-    for (auto const& c : header) {
-        cout << c << " | ";
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::Clear() {
+    vector<AvlNode*> stack;
+    if (root != nullptr && !Allocator<AvlNode>::BULK_RELEASE) {
+        stack.push_back(root);
     }
-    cout << "" << endl;
+    while (!stack.empty()) {
+        AvlNode* node = stack.back();
+        stack.pop_back();
+        if (node->left != nullptr) {
+            stack.push_back(node->left);
+        }
+        if (node->right != nullptr) {
+            stack.push_back(node->right);
+        }
+        pool.Destroy(node);
+    }
+    pool.Release();
+    secondary.Clear();
+    root = nullptr;
+}
+
+template <template <typename> class Allocator>
+const AllocationCounters& BalancedBinarySearchTree<Allocator>::Allocations() const {
+    return pool.Counters();
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::PrintStats(ostream& out) const {
+    out << "{\"container\": \"avl\", ";
+    writeTreeShapeJson(out, root);
+    out << ", \"search\": ";
+    searchStats.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, pool.Counters());
+    out << "}" << endl;
+}
+
+template <template <typename> class Allocator>
+int BalancedBinarySearchTree<Allocator>::height(AvlNode* node) {
+    return node == nullptr ? 0 : node->height;
+}
 
-    try {
-        for (unsigned int i = 0; i < file.rowCount(); i++) {
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::updateHeight(AvlNode* node) {
+    node->height = 1 + max(height(node->left), height(node->right));
+}
+
+template <template <typename> class Allocator>
+AvlNode* BalancedBinarySearchTree<Allocator>::rotateLeft(AvlNode* node) {
+    AvlNode* pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
 
-            bst->Insert(bid);
+template <template <typename> class Allocator>
+AvlNode* BalancedBinarySearchTree<Allocator>::rotateRight(AvlNode* node) {
+    AvlNode* pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+// Restore the AVL property at node and return the new subtree root
+template <template <typename> class Allocator>
+AvlNode* BalancedBinarySearchTree<Allocator>::rebalance(AvlNode* node) {
+    updateHeight(node);
+    int balance = height(node->left) - height(node->right);
+
+    if (balance > 1) {
+        if (height(node->left->left) < height(node->left->right)) {
+            node->left = rotateLeft(node->left);
         }
+        return rotateRight(node);
     }
-    catch (csv::Error& e) {
-        cerr << e.what() << endl;
+    if (balance < -1) {
+        if (height(node->right->right) < height(node->right->left)) {
+            node->right = rotateRight(node->right);
+        }
+        return rotateLeft(node);
     }
+    return node;
 }
 
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
+// Walk the recorded path bottom-up, rebalancing every ancestor
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::retrace(AvlNode** path[], int depth) {
+    for (int i = depth - 1; i >= 0; i--) {
+        *path[i] = rebalance(*path[i]);
+    }
 }
 
-int main(int argc, char* argv[]) {
-    string csvPath, bidKey;
-    switch (argc) {
-    case 2:
-        csvPath = argv[1];
-        bidKey = "98223";
-        break;
-    case 3:
-        csvPath = argv[1];
-        bidKey = argv[2];
-        break;
-    default:
-        csvPath = "eBid_Monthly_Sales.csv";
-        bidKey = "98223";
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::InsertRow(RowId row) {
+    AvlNode** path[MAX_DEPTH];
+    int depth = 0;
+    AvlNode** link = &root;
+    string_view bidId = store->BidId(row);
+
+    while (*link != nullptr) {
+        if (bidId == key(*link)) {
+            // Same id: replace the row, the shape does not change
+            secondary.Remove((*link)->row);
+            (*link)->row = row;
+            secondary.Add(row);
+            return;
+        }
+        path[depth++] = link;
+        if (bidId < key(*link)) {
+            link = &(*link)->left;
+        }
+        else {
+            link = &(*link)->right;
+        }
     }
 
+    *link = pool.Create(row);
+    retrace(path, depth);
+    secondary.Add(row);
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::Remove(string bidId) {
+    AvlNode** path[MAX_DEPTH];
+    int depth = 0;
+    AvlNode** link = &root;
+
+    while (*link != nullptr && key(*link) != bidId) {
+        path[depth++] = link;
+        if (bidId < key(*link)) {
+            link = &(*link)->left;
+        }
+        else {
+            link = &(*link)->right;
+        }
+    }
+
+    if (*link == nullptr) {
+        return;
+    }
+
+    AvlNode* node = *link;
+    secondary.Remove(node->row);
+    if (node->left != nullptr && node->right != nullptr) {
+        // Two children: take the in-order successor's row, then unlink
+        // the successor, which has no left child
+        path[depth++] = link;
+        AvlNode** successor = &node->right;
+        while ((*successor)->left != nullptr) {
+            path[depth++] = successor;
+            successor = &(*successor)->left;
+        }
+        node->row = (*successor)->row;
+        link = successor;
+        node = *successor;
+    }
+
+    *link = node->left != nullptr ? node->left : node->right;
+    pool.Destroy(node);
+    retrace(path, depth);
+}
+
+template <template <typename> class Allocator>
+BidSecondaryIndex::FundRange BalancedBinarySearchTree<Allocator>::SearchFund(string_view fund) const {
+    return secondary.Fund(fund);
+}
+
+template <template <typename> class Allocator>
+BidSecondaryIndex::AmountRange BalancedBinarySearchTree<Allocator>::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high);
+}
+
+// Same middle-out build as BinarySearchTree::BulkLoad. A subtree built
+// from n sorted bids this way has height floor(log2(n)) + 1, which is
+// recorded as each node is created.
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::BulkLoad(vector<RowId>& rows) {
+    if (root != nullptr) {
+        for (RowId row : rows) {
+            InsertRow(row);
+        }
+        rows.clear();
+        return;
+    }
+
+    sortRowsByBidId(store, rows);
+    keepLastRowPerBidId(store, rows);
+
+    struct Range {
+        size_t low;
+        size_t high;
+        AvlNode** link;
+    };
+    vector<Range> stack;
+    stack.push_back({ 0, rows.size(), &root });
+    while (!stack.empty()) {
+        Range range = stack.back();
+        stack.pop_back();
+        if (range.low >= range.high) {
+            continue;
+        }
+        size_t mid = range.low + (range.high - range.low) / 2;
+        AvlNode* node = pool.Create(rows[mid]);
+        node->height = 0;
+        for (size_t n = range.high - range.low; n > 0; n >>= 1) {
+            node->height++;
+        }
+        *range.link = node;
+        stack.push_back({ range.low, mid, &node->left });
+        stack.push_back({ mid + 1, range.high, &node->right });
+    }
+    secondary.AddRows(rows);
+    rows.clear();
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    searchTreeBatch(store, root, keys, results, searchStats);
+}
+
+template <template <typename> class Allocator>
+BidRef BalancedBinarySearchTree<Allocator>::Search(string bidId) {
+    AvlNode* current = root;
+    size_t comparisons = 0;
+
+    while (current != nullptr) {
+        comparisons++;
+        string_view currentId = key(current);
+        if (currentId == bidId) {
+            searchStats.Record(comparisons, true);
+            return BidRef(store, current->row);
+        }
+
+        if (bidId < currentId) {
+            current = current->left;
+        }
+        else {
+            current = current->right;
+        }
+    }
+
+    searchStats.Record(comparisons, false);
+    BidRef bid;
+    return bid;
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::InOrder() {
+    BidExporter out(cout);
+    forEachInOrder(root, [&](AvlNode* node) { out.Write(BidRef(store, node->row)); });
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::PostOrder() {
+    BidExporter out(cout);
+    forEachPostOrder(root, [&](AvlNode* node) { out.Write(BidRef(store, node->row)); });
+}
+
+template <template <typename> class Allocator>
+void BalancedBinarySearchTree<Allocator>::PreOrder() {
+    BidExporter out(cout);
+    forEachPreOrder(root, [&](AvlNode* node) { out.Write(BidRef(store, node->row)); });
+}
+
+template <template <typename> class Allocator>
+template <typename Visit>
+void BalancedBinarySearchTree<Allocator>::ForEach(Visit visit) {
+    forEachInOrder(root, [&](AvlNode* node) { visit(BidRef(store, node->row)); });
+}
+
+//============================================================================
+// B+tree ordered index
+//============================================================================
+
+const size_t CACHE_LINE_SIZE = 64;
+
+// Row ids live only in the leaves, which are chained left to right so an
+// ordered scan or range query never climbs back up the tree. Each node's
+// key array (views of bidIds in the store) is sized to a fixed number of
+// cache lines, so one lookup touches a handful of lines per level instead
+// of one node per comparison. A bid whose id is already present replaces
+// the indexed row.
+class BPlusTree {
+
+private:
+    static constexpr size_t NODE_KEY_BYTES = 8 * CACHE_LINE_SIZE;
+    static constexpr int ORDER = (int)(NODE_KEY_BYTES / sizeof(string_view));
+    static const int MAX_DEPTH = 32;
+
+    struct BNode {
+        bool leaf;
+        int count;
+        string_view keys[ORDER];
+
+        BNode(bool isLeaf) {
+            leaf = isLeaf;
+            count = 0;
+        }
+    };
+
+    struct InnerNode : BNode {
+        BNode* children[ORDER + 1];
+
+        InnerNode() : BNode(false) {
+        }
+    };
+
+    struct LeafNode : BNode {
+        RowId rows[ORDER];
+        LeafNode* next;
+
+        LeafNode() : BNode(true) {
+            next = nullptr;
+        }
+    };
+
+    BNode* root;
+    LeafNode* head;
+    BidStore* store;
+    SearchStats searchStats; // key comparisons per Search
+    BidSecondaryIndex secondary; // fund and amount lookups over the same rows
+
+    static int lowerBound(const BNode* node, string_view key);
+    static int childIndex(const InnerNode* node, string_view key);
+    static int searchSteps(int count);
+    LeafNode* findLeaf(string_view key, InnerNode* path[], int childAt[], int& depth) const;
+    const LeafNode* findLeaf(string_view key, size_t* comparisons = nullptr) const;
+    void insertIntoParent(InnerNode* path[], int childAt[], int depth, string_view key, BNode* right);
+
+public:
+    class Iterator {
+    private:
+        const BidStore* store;
+        const LeafNode* leaf;
+        int index;
+        string upper;
+        bool bounded;
+
+        void skipEmpty();
+
+    public:
+        Iterator();
+        Iterator(const BidStore* bidStore, const LeafNode* start, int position, const string& high, bool hasUpper);
+        BidRef operator*() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+    };
+
+    // Half-open [begin, end) view returned by Range
+    struct BidRange {
+        Iterator first;
+        Iterator last;
+
+        Iterator begin() const {
+            return first;
+        }
+
+        Iterator end() const {
+            return last;
+        }
+    };
+
+    BPlusTree(BidStore* bidStore);
+    virtual ~BPlusTree();
+    void InOrder();
+    template <typename Visit>
+    void ForEach(Visit visit);
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
+    void Remove(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    BidRange Range(const string& low, const string& high) const;
+    BidSecondaryIndex::FundRange SearchFund(string_view fund) const;
+    BidSecondaryIndex::AmountRange SearchAmount(double low, double high) const;
+    void BulkLoad(vector<RowId>& rows);
+    void PrintStats(ostream& out) const;
+};
+
+BPlusTree::Iterator::Iterator() {
+    store = nullptr;
+    leaf = nullptr;
+    index = 0;
+    bounded = false;
+}
+
+BPlusTree::Iterator::Iterator(const BidStore* bidStore, const LeafNode* start, int position, const string& high, bool hasUpper) {
+    store = bidStore;
+    leaf = start;
+    index = position;
+    upper = high;
+    bounded = hasUpper;
+    skipEmpty();
+}
+
+// Step over exhausted (or emptied) leaves and stop past the upper bound
+void BPlusTree::Iterator::skipEmpty() {
+    while (leaf != nullptr && index >= leaf->count) {
+        leaf = leaf->next;
+        index = 0;
+    }
+    if (leaf != nullptr && bounded && upper < leaf->keys[index]) {
+        leaf = nullptr;
+        index = 0;
+    }
+}
+
+BidRef BPlusTree::Iterator::operator*() const {
+    return BidRef(store, leaf->rows[index]);
+}
+
+BPlusTree::Iterator& BPlusTree::Iterator::operator++() {
+    index++;
+    skipEmpty();
+    return *this;
+}
+
+bool BPlusTree::Iterator::operator==(const Iterator& other) const {
+    return leaf == other.leaf && index == other.index;
+}
+
+bool BPlusTree::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+BPlusTree::BPlusTree(BidStore* bidStore) : secondary(bidStore) {
+    head = new LeafNode();
+    root = head;
+    store = bidStore;
+}
+
+BPlusTree::~BPlusTree() {
+    vector<BNode*> stack;
+    stack.push_back(root);
+    while (!stack.empty()) {
+        BNode* node = stack.back();
+        stack.pop_back();
+        if (node->leaf) {
+            delete static_cast<LeafNode*>(node);
+        }
+        else {
+            InnerNode* inner = static_cast<InnerNode*>(node);
+            for (int i = 0; i <= inner->count; i++) {
+                stack.push_back(inner->children[i]);
+            }
+            delete inner;
+        }
+    }
+}
+
+// First slot whose key is not less than key
+int BPlusTree::lowerBound(const BNode* node, string_view key) {
+    return (int)(std::lower_bound(node->keys, node->keys + node->count, key) - node->keys);
+}
+
+// Child i holds keys below keys[i]; keys equal to a separator go right
+int BPlusTree::childIndex(const InnerNode* node, string_view key) {
+    return (int)(std::upper_bound(node->keys, node->keys + node->count, key) - node->keys);
+}
+
+BPlusTree::LeafNode* BPlusTree::findLeaf(string_view key, InnerNode* path[], int childAt[], int& depth) const {
+    BNode* node = root;
+    depth = 0;
+    while (!node->leaf) {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        int child = childIndex(inner, key);
+        path[depth] = inner;
+        childAt[depth] = child;
+        depth++;
+        node = inner->children[child];
+    }
+    return static_cast<LeafNode*>(node);
+}
+
+// Comparisons a binary search over count keys makes
+int BPlusTree::searchSteps(int count) {
+    int steps = 0;
+    while (count > 0) {
+        steps++;
+        count >>= 1;
+    }
+    return steps;
+}
+
+const BPlusTree::LeafNode* BPlusTree::findLeaf(string_view key, size_t* comparisons) const {
+    const BNode* node = root;
+    while (!node->leaf) {
+        const InnerNode* inner = static_cast<const InnerNode*>(node);
+        if (comparisons != nullptr) {
+            *comparisons += searchSteps(inner->count);
+        }
+        node = inner->children[childIndex(inner, key)];
+    }
+    return static_cast<const LeafNode*>(node);
+}
+
+// Add separator key with right as the child after path[depth - 1]'s
+// childAt slot, splitting full inner nodes up to the root as needed
+void BPlusTree::insertIntoParent(InnerNode* path[], int childAt[], int depth, string_view key, BNode* right) {
+    string_view separator = key;
+
+    for (int level = depth - 1; level >= 0; level--) {
+        InnerNode* parent = path[level];
+        int pos = childAt[level];
+
+        if (parent->count < ORDER) {
+            for (int i = parent->count; i > pos; i--) {
+                parent->keys[i] = std::move(parent->keys[i - 1]);
+                parent->children[i + 1] = parent->children[i];
+            }
+            parent->keys[pos] = separator;
+            parent->children[pos + 1] = right;
+            parent->count++;
+            return;
+        }
+
+        // Full: lay out ORDER + 1 keys, keep the lower half, push the
+        // middle key up and move the upper half into a new sibling
+        string_view keys[ORDER + 1];
+        BNode* children[ORDER + 2];
+        for (int i = 0, j = 0; i <= ORDER; i++) {
+            if (i == pos) {
+                keys[i] = separator;
+            }
+            else {
+                keys[i] = std::move(parent->keys[j++]);
+            }
+        }
+        for (int i = 0, j = 0; i <= ORDER + 1; i++) {
+            if (i == pos + 1) {
+                children[i] = right;
+            }
+            else {
+                children[i] = parent->children[j++];
+            }
+        }
+
+        int mid = (ORDER + 1) / 2;
+        InnerNode* sibling = new InnerNode();
+        parent->count = mid;
+        for (int i = 0; i < mid; i++) {
+            parent->keys[i] = std::move(keys[i]);
+            parent->children[i] = children[i];
+        }
+        parent->children[mid] = children[mid];
+
+        sibling->count = ORDER - mid;
+        for (int i = 0; i < sibling->count; i++) {
+            sibling->keys[i] = std::move(keys[mid + 1 + i]);
+            sibling->children[i] = children[mid + 1 + i];
+        }
+        sibling->children[sibling->count] = children[ORDER + 1];
+
+        separator = std::move(keys[mid]);
+        right = sibling;
+    }
+
+    // The root itself split
+    InnerNode* newRoot = new InnerNode();
+    newRoot->count = 1;
+    newRoot->keys[0] = separator;
+    newRoot->children[0] = root;
+    newRoot->children[1] = right;
+    root = newRoot;
+}
+
+void BPlusTree::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+void BPlusTree::InsertRow(RowId row) {
+    InnerNode* path[MAX_DEPTH];
+    int childAt[MAX_DEPTH];
+    int depth = 0;
+    string_view bidId = store->BidId(row);
+    LeafNode* leaf = findLeaf(bidId, path, childAt, depth);
+
+    int pos = lowerBound(leaf, bidId);
+    if (pos < leaf->count && leaf->keys[pos] == bidId) {
+        secondary.Remove(leaf->rows[pos]);
+        leaf->rows[pos] = row;
+        secondary.Add(row);
+        return;
+    }
+
+    if (leaf->count == ORDER) {
+        // Split the full leaf in half and link the new one after it
+        LeafNode* sibling = new LeafNode();
+        int mid = ORDER / 2;
+        sibling->count = ORDER - mid;
+        for (int i = 0; i < sibling->count; i++) {
+            sibling->keys[i] = leaf->keys[mid + i];
+            sibling->rows[i] = leaf->rows[mid + i];
+        }
+        leaf->count = mid;
+        sibling->next = leaf->next;
+        leaf->next = sibling;
+
+        insertIntoParent(path, childAt, depth, sibling->keys[0], sibling);
+
+        if (pos > mid) {
+            pos -= mid;
+            leaf = sibling;
+        }
+    }
+
+    for (int i = leaf->count; i > pos; i--) {
+        leaf->keys[i] = leaf->keys[i - 1];
+        leaf->rows[i] = leaf->rows[i - 1];
+    }
+    leaf->keys[pos] = bidId;
+    leaf->rows[pos] = row;
+    leaf->count++;
+    secondary.Add(row);
+}
+
+// Leaves are allowed to underflow (even to empty); separators stay valid
+// because they only bound the key ranges, and iteration skips empty leaves
+void BPlusTree::Remove(string bidId) {
+    InnerNode* path[MAX_DEPTH];
+    int childAt[MAX_DEPTH];
+    int depth = 0;
+    LeafNode* leaf = findLeaf(bidId, path, childAt, depth);
+    int pos = lowerBound(leaf, bidId);
+    if (pos == leaf->count || leaf->keys[pos] != bidId) {
+        return;
+    }
+
+    secondary.Remove(leaf->rows[pos]);
+    for (int i = pos; i < leaf->count - 1; i++) {
+        leaf->keys[i] = leaf->keys[i + 1];
+        leaf->rows[i] = leaf->rows[i + 1];
+    }
+    leaf->count--;
+}
+
+BidRef BPlusTree::Search(string bidId) {
+    size_t comparisons = 0;
+    const LeafNode* leaf = findLeaf(bidId, STATS_ENABLED ? &comparisons : nullptr);
+    int pos = lowerBound(leaf, bidId);
+    comparisons += searchSteps(leaf->count);
+    if (pos < leaf->count && leaf->keys[pos] == bidId) {
+        searchStats.Record(comparisons, true);
+        return BidRef(store, leaf->rows[pos]);
+    }
+
+    searchStats.Record(comparisons, false);
+    BidRef bid;
+    return bid;
+}
+
+// Batched lookups in the style of the binary trees' searchTreeBatch,
+// two steps per level: the node header first (its count says how many
+// key lines to fetch), then every key line before the binary search.
+// Comparisons still read id characters from the store, which stay
+// unprefetched misses.
+void BPlusTree::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    enum Stage { HEADER, KEYS, DONE };
+    struct Lane {
+        Stage stage;
+        size_t index;
+        const BNode* node;
+        size_t comparisons;
+    };
+
+    results.assign(keys.size(), BidRef());
+    Lane lanes[BATCH_LANES];
+    size_t next = 0;
+    size_t active = 0;
+    auto visit = [&](Lane& lane, const BNode* node) {
+        lane.node = node;
+        lane.stage = HEADER;
+        prefetchRead(node);
+    };
+    auto start = [&](Lane& lane) {
+        if (next == keys.size()) {
+            lane.stage = DONE;
+            return;
+        }
+        lane.index = next++;
+        lane.comparisons = 0;
+        visit(lane, root);
+        active++;
+    };
+
+    for (Lane& lane : lanes) {
+        start(lane);
+    }
+    while (active > 0) {
+        for (Lane& lane : lanes) {
+            switch (lane.stage) {
+            case HEADER: {
+                const char* first = reinterpret_cast<const char*>(lane.node->keys);
+                const char* last = reinterpret_cast<const char*>(lane.node->keys + lane.node->count);
+                for (const char* line = first; line < last; line += CACHE_LINE_SIZE) {
+                    prefetchRead(line);
+                }
+                lane.stage = KEYS;
+                break;
+            }
+            case KEYS: {
+                string_view bidId = keys[lane.index];
+                lane.comparisons += searchSteps(lane.node->count);
+                if (!lane.node->leaf) {
+                    const InnerNode* inner = static_cast<const InnerNode*>(lane.node);
+                    visit(lane, inner->children[childIndex(inner, bidId)]);
+                    break;
+                }
+                const LeafNode* leaf = static_cast<const LeafNode*>(lane.node);
+                int pos = lowerBound(leaf, bidId);
+                bool hit = pos < leaf->count && leaf->keys[pos] == bidId;
+                if (hit) {
+                    results[lane.index] = BidRef(store, leaf->rows[pos]);
+                }
+                searchStats.Record(lane.comparisons, hit);
+                active--;
+                start(lane);
+                break;
+            }
+            case DONE:
+                break;
+            }
+        }
+    }
+}
+
+// JSON dump: levels, node counts and how full the leaves are (bulk loads
+// fill them to three quarters, splits leave them half full)
+void BPlusTree::PrintStats(ostream& out) const {
+    size_t levels = 1;
+    for (const BNode* node = root; !node->leaf; node = static_cast<const InnerNode*>(node)->children[0]) {
+        levels++;
+    }
+    size_t innerNodes = 0;
+    size_t leaves = 0;
+    size_t entries = 0;
+    Histogram leafFill;
+    vector<const BNode*> stack;
+    stack.push_back(root);
+    while (!stack.empty()) {
+        const BNode* node = stack.back();
+        stack.pop_back();
+        if (node->leaf) {
+            leaves++;
+            entries += node->count;
+            leafFill.Record(node->count);
+        }
+        else {
+            innerNodes++;
+            const InnerNode* inner = static_cast<const InnerNode*>(node);
+            for (int i = 0; i <= inner->count; i++) {
+                stack.push_back(inner->children[i]);
+            }
+        }
+    }
+
+    out << "{\"container\": \"bplus\", \"order\": " << ORDER << ", \"entries\": " << entries << ", \"height\": " << levels
+        << ", \"inner_nodes\": " << innerNodes << ", \"leaves\": " << leaves
+        << ", \"leaf_fill\": " << (leaves == 0 ? 0.0 : (double)entries / (double)(leaves * ORDER)) << ", \"keys_per_leaf\": ";
+    leafFill.WriteJson(out);
+    out << ", \"search\": ";
+    searchStats.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, AllocationCounters());
+    out << "}" << endl;
+}
+
+// Fills leaves three-quarters full from the sorted rows (leaving room
+// for later inserts) and then builds each inner level from the one below.
+// When an id repeats, the last row wins, as with Insert.
+void BPlusTree::BulkLoad(vector<RowId>& rows) {
+    if (root != head || head->count > 0) {
+        for (RowId row : rows) {
+            InsertRow(row);
+        }
+        rows.clear();
+        return;
+    }
+
+    sortRowsByBidId(store, rows);
+    keepLastRowPerBidId(store, rows);
+
+    const int leafFill = max(1, ORDER * 3 / 4);
+    vector<BNode*> level;
+    vector<string_view> firstKeys;
+    LeafNode* leaf = head;
+    for (size_t i = 0; i < rows.size(); i++) {
+        string_view bidId = store->BidId(rows[i]);
+        if (leaf->count == leafFill) {
+            LeafNode* next = new LeafNode();
+            leaf->next = next;
+            leaf = next;
+        }
+        if (leaf->count == 0) {
+            level.push_back(leaf);
+            firstKeys.push_back(bidId);
+        }
+        leaf->keys[leaf->count] = bidId;
+        leaf->rows[leaf->count] = rows[i];
+        leaf->count++;
+    }
+    secondary.AddRows(rows);
+    rows.clear();
+
+    // Spread each level's nodes evenly over parents of up to ORDER + 1
+    // children; a parent's separators are the first keys of its children
+    while (level.size() > 1) {
+        size_t parents = (level.size() + ORDER) / (ORDER + 1);
+        vector<BNode*> upper;
+        vector<string_view> upperKeys;
+        size_t child = 0;
+        for (size_t p = 0; p < parents; p++) {
+            size_t take = (level.size() - child) / (parents - p);
+            InnerNode* inner = new InnerNode();
+            inner->count = (int)take - 1;
+            for (size_t i = 0; i < take; i++) {
+                inner->children[i] = level[child + i];
+                if (i > 0) {
+                    inner->keys[i - 1] = firstKeys[child + i];
+                }
+            }
+            upper.push_back(inner);
+            upperKeys.push_back(firstKeys[child]);
+            child += take;
+        }
+        level.swap(upper);
+        firstKeys.swap(upperKeys);
+    }
+    if (!level.empty()) {
+        root = level[0];
+    }
+}
+
+// All bids with low <= bidId <= high, in order
+BPlusTree::BidRange BPlusTree::Range(const string& low, const string& high) const {
+    BidRange range;
+    if (high < low) {
+        return range;
+    }
+
+    const LeafNode* leaf = findLeaf(low);
+    range.first = Iterator(store, leaf, lowerBound(leaf, low), high, true);
+    return range;
+}
+
+BidSecondaryIndex::FundRange BPlusTree::SearchFund(string_view fund) const {
+    return secondary.Fund(fund);
+}
+
+BidSecondaryIndex::AmountRange BPlusTree::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high);
+}
+
+void BPlusTree::InOrder() {
+    BidExporter out(cout);
+    ForEach([&](BidRef bid) { out.Write(bid); });
+}
+
+// Every bid in id order, straight along the leaf chain
+template <typename Visit>
+void BPlusTree::ForEach(Visit visit) {
+    for (Iterator it(store, head, 0, "", false); it != Iterator(); ++it) {
+        visit(*it);
+    }
+}
+
+//============================================================================
+// Bulk load ordering shared by the trees
+//============================================================================
+
+// Orders row ids by bidId, equal ids keeping their load order. Rows
+// restored from a snapshot arrive sorted, so one linear check skips the sort.
+void sortRowsByBidId(const BidStore* store, vector<RowId>& rows) {
+    auto less = [store](RowId a, RowId b) {
+        return store->BidId(a) < store->BidId(b);
+    };
+    if (!is_sorted(rows.begin(), rows.end(), less)) {
+        stable_sort(rows.begin(), rows.end(), less);
+    }
+}
+
+// Drops all but the last row of each id from rows sorted by
+// sortRowsByBidId, so a bulk load ends up as inserting them in turn would
+void keepLastRowPerBidId(const BidStore* store, vector<RowId>& rows) {
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i + 1 < rows.size() && store->BidId(rows[i + 1]) == store->BidId(rows[i])) {
+            continue;
+        }
+        rows[kept++] = rows[i];
+    }
+    rows.resize(kept);
+}
+
+//============================================================================
+// Static methods used for testing
+//============================================================================
+
+// Appends the CSV's bids to the store, then builds the tree in one pass
+// over their row ids instead of inserting row by row
+template <typename Tree>
+LoadTimings loadBids(string csvPath, BidStore* store, Tree* bst) {
+    LoadTimings timings;
+    vector<RowId> rows = loadBidCsv(csvPath, store, timings, &cout);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bst->BulkLoad(rows);
+    timings.buildSeconds += secondsSince(start);
+
+    return timings;
+}
+
+template <typename Tree>
+int runMenu(string csvPath, string bidKey) {
     clock_t ticks;
-    BinarySearchTree* bst = new BinarySearchTree();
-    Bid bid;
+    BidStore store;
+    Tree* bst = new Tree(&store);
+    BidRef bid;
+    RowId firstRow;
+    vector<TraceEvent> events;
+    string tracePath;
     int choice = 0;
 
+    // Set BID_TRACE to record every menu operation for later replay
+    TraceWriter trace;
+    openTraceFromEnvironment(trace);
+
     while (choice != 9) {
         cout << "\nMenu:" << endl;
         cout << "  1. Load Bids" << endl;
         cout << "  2. Display All Bids" << endl;
         cout << "  3. Find Bid" << endl;
         cout << "  4. Remove Bid" << endl;
+        if (is_same<Tree, BPlusTree>::value) {
+            cout << "  5. Find Bids in Id Range" << endl;
+        }
+        cout << "  6. Replay Trace" << endl;
+        cout << "  7. Stats" << endl;
+        cout << "  8. Export Bids" << endl;
         cout << "  9. Exit" << endl;
+        cout << " 10. Save Snapshot" << endl;
+        cout << " 11. Load Snapshot" << endl;
+        cout << " 12. Find Bids by Fund" << endl;
+        cout << " 13. Find Bids by Amount" << endl;
+        cout << " 14. Search Snapshot" << endl;
         cout << "Enter choice: ";
         cin >> choice;
 
         switch (choice) {
         case 1:
             ticks = clock();
-            loadBids(csvPath, bst);
+            firstRow = (RowId)store.Size();
+            printLoadTimings(loadBids(csvPath, &store, bst));
             ticks = clock() - ticks;
+            if (trace.IsOpen()) {
+                for (RowId row = firstRow; row < store.Size(); row++) {
+                    trace.Insert(BidRef(&store, row));
+                }
+            }
             cout << "time: " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
             break;
 
         case 2:
+            trace.Print();
             bst->InOrder();
             break;
 
         case 3:
+            trace.Search(bidKey);
             ticks = clock();
             bid = bst->Search(bidKey);
             ticks = clock() - ticks;
 
-            if (!bid.bidId.empty()) {
+            if (bid.valid()) {
                 displayBid(bid);
             }
             else {
@@ -320,8 +1610,89 @@ int main(int argc, char* argv[]) {
             break;
 
         case 4:
+            trace.Remove(bidKey);
             bst->Remove(bidKey);
             break;
+
+        case 5:
+            if constexpr (is_same<Tree, BPlusTree>::value) {
+                string low, high;
+                cout << "Enter lowest Id: ";
+                cin >> low;
+                cout << "Enter highest Id: ";
+                cin >> high;
+
+                ticks = clock();
+                BidExporter out(cout);
+                for (BidRef match : bst->Range(low, high)) {
+                    out.Write(match);
+                }
+                out.Close();
+                ticks = clock() - ticks;
+                size_t found = out.Rows();
+
+                cout << found << " bids in range" << endl;
+                cout << "time: " << ticks << " clock ticks" << endl;
+                cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            }
+            break;
+
+        // Replays against the current tree, so load first to replay on
+        // top of the CSV bids
+        case 6:
+            cout << "Enter trace file: ";
+            cin >> tracePath;
+            if (readTrace(tracePath, events)) {
+                printReplayStats(replayTrace(events, *bst, [](Tree& tree) { tree.InOrder(); }));
+            }
+            events.clear();
+            break;
+
+        case 7:
+            bst->PrintStats(cout);
+            break;
+
+        case 8:
+            exportFromMenu([&](auto write) { bst->ForEach(write); });
+            break;
+
+        case 10: {
+            vector<RowId> rows;
+            bst->ForEach([&](BidRef saved) { rows.push_back(saved.row); });
+            ticks = clock();
+            if (saveSnapshot(promptSnapshotPath(), "tree", store, rows)) {
+                ticks = clock() - ticks;
+                cout << rows.size() << " bids saved" << endl;
+                cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            }
+            break;
+        }
+
+        // The snapshot's id index feeds BulkLoad in sorted order, so an
+        // empty tree is built without sorting
+        case 11:
+            firstRow = (RowId)store.Size();
+            loadSnapshot(promptSnapshotPath(), store, [&](vector<RowId>&, vector<RowId>& sortedRows) {
+                bst->BulkLoad(sortedRows);
+            });
+            if (trace.IsOpen()) {
+                for (RowId row = firstRow; row < store.Size(); row++) {
+                    trace.Insert(BidRef(&store, row));
+                }
+            }
+            break;
+
+        case 12:
+            fundQueryFromMenu([&](const string& fund) { return bst->SearchFund(fund); });
+            break;
+
+        case 13:
+            amountQueryFromMenu([&](double low, double high) { return bst->SearchAmount(low, high); });
+            break;
+
+        case 14:
+            searchSnapshotFromMenu();
+            break;
         }
     }
 
@@ -329,3 +1700,36 @@ int main(int argc, char* argv[]) {
     delete bst;
     return 0;
 }
+
+
+int main(int argc, char* argv[]) {
+    string csvPath, bidKey, engine;
+    switch (argc) {
+    case 2:
+        csvPath = argv[1];
+        bidKey = "98223";
+        break;
+    case 3:
+        csvPath = argv[1];
+        bidKey = argv[2];
+        break;
+    case 4:
+        csvPath = argv[1];
+        bidKey = argv[2];
+        engine = argv[3];
+        break;
+    default:
+        csvPath = "eBid_Monthly_Sales.csv";
+        bidKey = "98223";
+    }
+
+    // "avl" selects the self-balancing tree, "bplus" the B+tree index,
+    // anything else the plain one
+    if (engine == "avl") {
+        return runMenu<BalancedBinarySearchTree<>>(csvPath, bidKey);
+    }
+    if (engine == "bplus") {
+        return runMenu<BPlusTree>(csvPath, bidKey);
+    }
+    return runMenu<BinarySearchTree<>>(csvPath, bidKey);
+}
\ No newline at end of file
@@ -7,217 +7,1544 @@
 //============================================================================
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string> // atoi
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <time.h>
 
-#include "CSVparser.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "BidExport.hpp"
+#include "BidIndex.hpp"
+#include "BidSnapshot.hpp"
+#include "BidStats.hpp"
+#include "BidStore.hpp"
+#include "BidTrace.hpp"
+#include "MappedCsv.hpp"
+#include "NodePool.hpp"
 
 using namespace std;
 
 const unsigned int DEFAULT_SIZE = 179;
+const float DEFAULT_MAX_LOAD_FACTOR = 1.0f;
+const unsigned int REHASH_STEP = 4; // old buckets moved per operation while growing
+const size_t BATCH_LANES = 16;      // lookups in flight at once in SearchBatch
+
+//============================================================================
+// Hasher policies
+//============================================================================
 
-double strToDouble(string str, char ch);
+// Default hasher: mixes the raw bidId bytes eight at a time, so any id
+// (numeric or not) hashes without parsing and without a division
+struct BidIdHasher {
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    size_t operator()(string_view key) const {
+        const uint64_t K = 0x9e3779b97f4a7c15ULL;
+        const char* data = key.data();
+        size_t len = key.size();
+        uint64_t h = len * K;
+
+        while (len >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            h = (h ^ mix(word)) * K;
+            data += 8;
+            len -= 8;
+        }
 
-struct Bid {
-    string bidId;
-    string title;
-    string fund;
-    double amount;
+        uint64_t tail = 0;
+        memcpy(&tail, data, len);
+        h = (h ^ mix(tail)) * K;
 
-    Bid() {
-        amount = 0.0;
+        return (size_t)mix(h);
     }
 };
 
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | " << bid.fund << endl;
-}
+// The original scheme: parse the id as an int. Only works for numeric ids.
+struct LegacyIntHasher {
+    size_t operator()(string_view key) const {
+        return (size_t)stoi(string(key));
+    }
+};
 
+//============================================================================
+// Chained hash table
+//============================================================================
+
+template <typename Hasher = BidIdHasher, template <typename> class Allocator = NodePool>
 class HashTable {
 
 private:
     struct Node {
-        Bid bid;
-        unsigned int key;
+        RowId row;
+        size_t key; // full hash of the row's bidId
         Node* next;
 
         Node() {
-            key = UINT_MAX;
+            row = NO_ROW;
+            key = 0;
             next = nullptr;
         }
 
-        Node(Bid aBid) : Node() {
-            bid = aBid;
-        }
-
-        Node(Bid aBid, unsigned int aKey) : Node(aBid) {
+        Node(RowId aRow, size_t aKey) : Node() {
+            row = aRow;
             key = aKey;
         }
     };
 
-    vector<Node> nodes;
+    // Buckets hold chain heads. While the table is growing, buckets below
+    // migrateIndex in oldNodes have already been moved into nodes.
+    vector<Node*> nodes;
+    vector<Node*> oldNodes;
     unsigned int tableSize = DEFAULT_SIZE;
+    unsigned int oldTableSize = 0;
+    unsigned int migrateIndex = 0;
+    unsigned int count = 0;
+    float maxLoadFactor = DEFAULT_MAX_LOAD_FACTOR;
+    BidStore* store;
+    Hasher hasher;
+    Allocator<Node> pool;
+    SearchStats searchStats; // chain nodes compared per Search
+    BidSecondaryIndex secondary; // fund and amount lookups over the same rows
 
-    unsigned int hash(int key);
+    unsigned int hash(size_t key);
+    static unsigned int roundUpPowerOfTwo(unsigned int n);
+    bool isRehashing() const;
+    Node** findBucket(size_t key);
+    void startRehash(unsigned int newSize);
+    void rehashStep(unsigned int buckets);
+    void finishRehash();
 
 public:
-    HashTable();
-    HashTable(unsigned int size);
+    HashTable(BidStore* bidStore);
+    HashTable(BidStore* bidStore, unsigned int size);
     virtual ~HashTable();
-    void Insert(Bid bid);
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
     void PrintAll();
+    template <typename Visit>
+    void ForEach(Visit visit);
     void Remove(string bidId);
-    Bid Search(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    BidSecondaryIndex::FundRange SearchFund(string_view fund) const;
+    BidSecondaryIndex::AmountRange SearchAmount(double low, double high) const;
+    void reserve(unsigned int n);
+    void setMaxLoadFactor(float factor);
+    float loadFactor() const;
+    void Clear();
+    const AllocationCounters& Allocations() const;
+    void PrintStats(ostream& out) const;
 };
 
-HashTable::HashTable() {
-    nodes.resize(tableSize);
+template <typename Hasher, template <typename> class Allocator>
+HashTable<Hasher, Allocator>::HashTable(BidStore* bidStore) : secondary(bidStore) {
+    store = bidStore;
+    tableSize = roundUpPowerOfTwo(tableSize);
+    nodes.resize(tableSize, nullptr);
 }
 
-HashTable::HashTable(unsigned int size) {
-    tableSize = size;
-    nodes.resize(tableSize);
+template <typename Hasher, template <typename> class Allocator>
+HashTable<Hasher, Allocator>::HashTable(BidStore* bidStore, unsigned int size) : secondary(bidStore) {
+    store = bidStore;
+    tableSize = roundUpPowerOfTwo(size);
+    nodes.resize(tableSize, nullptr);
 }
 
-HashTable::~HashTable() {
-    for (unsigned int i = 0; i < nodes.size(); i++) {
-        Node* currentNode = nodes[i].next;
+template <typename Hasher, template <typename> class Allocator>
+HashTable<Hasher, Allocator>::~HashTable() {
+    Clear();
+}
+
+// Drops every bid. A pooled allocator frees its slabs in one go; otherwise
+// each chain is walked and freed node by node.
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::Clear() {
+    vector<Node*>* tables[] = { &oldNodes, &nodes };
+    for (vector<Node*>* table : tables) {
+        if (!Allocator<Node>::BULK_RELEASE) {
+            for (unsigned int i = 0; i < table->size(); i++) {
+                Node* currentNode = (*table)[i];
+                while (currentNode != nullptr) {
+                    Node* temp = currentNode;
+                    currentNode = currentNode->next;
+                    pool.Destroy(temp);
+                }
+            }
+        }
+        table->assign(table->size(), nullptr);
+    }
+    pool.Release();
+    secondary.Clear();
+
+    oldNodes.clear();
+    oldTableSize = 0;
+    migrateIndex = 0;
+    count = 0;
+}
+
+template <typename Hasher, template <typename> class Allocator>
+const AllocationCounters& HashTable<Hasher, Allocator>::Allocations() const {
+    return pool.Counters();
+}
+
+// Table sizes are powers of two, so the bucket is a mask, not a modulo
+template <typename Hasher, template <typename> class Allocator>
+unsigned int HashTable<Hasher, Allocator>::hash(size_t key) {
+    return (unsigned int)(key & (tableSize - 1));
+}
+
+template <typename Hasher, template <typename> class Allocator>
+unsigned int HashTable<Hasher, Allocator>::roundUpPowerOfTwo(unsigned int n) {
+    unsigned int size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+template <typename Hasher, template <typename> class Allocator>
+bool HashTable<Hasher, Allocator>::isRehashing() const {
+    return !oldNodes.empty();
+}
+
+// Returns the chain that currently owns key, old or new
+template <typename Hasher, template <typename> class Allocator>
+typename HashTable<Hasher, Allocator>::Node** HashTable<Hasher, Allocator>::findBucket(size_t key) {
+    if (isRehashing()) {
+        unsigned int oldBucket = (unsigned int)(key & (oldTableSize - 1));
+        if (oldBucket >= migrateIndex) {
+            return &oldNodes[oldBucket];
+        }
+    }
+    return &nodes[hash(key)];
+}
+
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::startRehash(unsigned int newSize) {
+    finishRehash();
+
+    oldNodes.swap(nodes);
+    oldTableSize = tableSize;
+    migrateIndex = 0;
+
+    tableSize = newSize;
+    nodes.assign(tableSize, nullptr);
+}
+
+// Move a few old buckets into the new table so no single call pays for
+// the whole rebuild
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::rehashStep(unsigned int buckets) {
+    while (isRehashing() && buckets > 0) {
+        Node* currentNode = oldNodes[migrateIndex];
         while (currentNode != nullptr) {
-            Node* temp = currentNode;
-            currentNode = currentNode->next;
-            delete temp;
+            Node* next = currentNode->next;
+            unsigned int bucket = hash(currentNode->key);
+            currentNode->next = nodes[bucket];
+            nodes[bucket] = currentNode;
+            currentNode = next;
+        }
+        oldNodes[migrateIndex] = nullptr;
+        migrateIndex++;
+        buckets--;
+
+        if (migrateIndex == oldTableSize) {
+            oldNodes.clear();
+            oldNodes.shrink_to_fit();
+            oldTableSize = 0;
+            migrateIndex = 0;
         }
     }
-    nodes.clear();
 }
 
-unsigned int HashTable::hash(int key) {
-    return key % tableSize;
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::finishRehash() {
+    rehashStep(UINT_MAX);
 }
 
-void HashTable::Insert(Bid bid) {
-    unsigned int key = hash(stoi(bid.bidId));
-    Node* currentNode = &nodes[key];
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::reserve(unsigned int n) {
+    unsigned int wanted = roundUpPowerOfTwo((unsigned int)(n / maxLoadFactor) + 1);
+    if (wanted > tableSize) {
+        // Reserving is an explicit request, so the move is done up front
+        startRehash(wanted);
+        finishRehash();
+    }
+}
 
-    if (currentNode->key == UINT_MAX) {
-        currentNode->key = key;
-        currentNode->bid = bid;
-        return;
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::setMaxLoadFactor(float factor) {
+    if (factor > 0.0f) {
+        maxLoadFactor = factor;
     }
+}
 
-    // Traverse to the end and add the new node
-    while (currentNode->next != nullptr) {
-        currentNode = currentNode->next;
+template <typename Hasher, template <typename> class Allocator>
+float HashTable<Hasher, Allocator>::loadFactor() const {
+    return (float)count / tableSize;
+}
+
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+// Indexes a row that is already in the store. An existing bid with the
+// same id is replaced, as in every other container.
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::InsertRow(RowId row) {
+    rehashStep(REHASH_STEP);
+
+    string_view bidId = store->BidId(row);
+    size_t key = hasher(bidId);
+    Node** bucket = findBucket(key);
+    for (Node* currentNode = *bucket; currentNode != nullptr; currentNode = currentNode->next) {
+        if (currentNode->key == key && store->BidId(currentNode->row) == bidId) {
+            secondary.Remove(currentNode->row);
+            currentNode->row = row;
+            secondary.Add(row);
+            return;
+        }
+    }
+
+    if (!isRehashing() && (float)(count + 1) / tableSize > maxLoadFactor) {
+        startRehash(tableSize * 2);
+        rehashStep(REHASH_STEP);
+        bucket = findBucket(key);
     }
-    currentNode->next = new Node(bid, key);
+
+    // Prepend to the chain; order within a chain does not matter
+    Node* node = pool.Create(row, key);
+    node->next = *bucket;
+    *bucket = node;
+    count++;
+    secondary.Add(row);
 }
 
-void HashTable::PrintAll() {
-    for (unsigned int i = 0; i < tableSize; i++) {
-        Node* currentNode = &nodes[i];
-        if (currentNode->key != UINT_MAX) {
+// Buffered through one exporter rather than a flushed displayBid per bid
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::PrintAll() {
+    BidExporter out(cout);
+    ForEach([&](BidRef bid) { out.Write(bid); });
+}
+
+// Every bid in bucket order, old table first while growing
+template <typename Hasher, template <typename> class Allocator>
+template <typename Visit>
+void HashTable<Hasher, Allocator>::ForEach(Visit visit) {
+    vector<Node*>* tables[] = { &oldNodes, &nodes };
+    for (vector<Node*>* table : tables) {
+        for (unsigned int i = 0; i < table->size(); i++) {
+            Node* currentNode = (*table)[i];
             while (currentNode != nullptr) {
-                displayBid(currentNode->bid);
+                visit(BidRef(store, currentNode->row));
                 currentNode = currentNode->next;
             }
         }
     }
 }
 
-void HashTable::Remove(string bidId) {
-    unsigned int key = hash(stoi(bidId));
-    Node* currentNode = &nodes[key];
-    Node* previousNode = nullptr;
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::Remove(string bidId) {
+    rehashStep(REHASH_STEP);
 
-    while (currentNode != nullptr && currentNode->bid.bidId != bidId) {
-        previousNode = currentNode;
+    // Cached hashes reject most chain neighbours without a string compare
+    size_t key = hasher(bidId);
+    Node** link = findBucket(key);
+    while (*link != nullptr && ((*link)->key != key || store->BidId((*link)->row) != bidId)) {
+        link = &(*link)->next;
+    }
+
+    if (*link != nullptr) {
+        Node* temp = *link;
+        *link = temp->next;
+        secondary.Remove(temp->row);
+        pool.Destroy(temp);
+        count--;
+    }
+}
+
+// Every bid for fund, through the secondary index
+template <typename Hasher, template <typename> class Allocator>
+BidSecondaryIndex::FundRange HashTable<Hasher, Allocator>::SearchFund(string_view fund) const {
+    return secondary.Fund(fund);
+}
+
+// Every bid with low <= amount <= high, smallest first
+template <typename Hasher, template <typename> class Allocator>
+BidSecondaryIndex::AmountRange HashTable<Hasher, Allocator>::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high);
+}
+
+template <typename Hasher, template <typename> class Allocator>
+BidRef HashTable<Hasher, Allocator>::Search(string bidId) {
+    BidRef bid;
+    rehashStep(REHASH_STEP);
+
+    size_t key = hasher(bidId);
+    size_t probes = 0;
+    Node* currentNode = *findBucket(key);
+    while (currentNode != nullptr) {
+        probes++;
+        if (currentNode->key == key && store->BidId(currentNode->row) == bidId) {
+            searchStats.Record(probes, true);
+            return BidRef(store, currentNode->row);
+        }
         currentNode = currentNode->next;
     }
 
-    if (currentNode != nullptr && currentNode->bid.bidId == bidId) {
-        if (previousNode == nullptr) {
-            // First node in chain
-            if (currentNode->next != nullptr) {
-                Node* temp = currentNode->next;
-                *currentNode = *temp;
-                delete temp;
+    searchStats.Record(probes, false);
+    return bid;
+}
+
+// Same answers as calling Search on each key, but up to BATCH_LANES
+// lookups are in flight at once (asynchronous memory access chaining).
+// Every lane stops right after prefetching what its next step reads, the
+// bucket, a chain node, the id column entry or the id's characters, and
+// the loop moves on to the other lanes while that line arrives.
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    enum Stage { BUCKET, NODE, ROW, KEY, DONE };
+    struct Lane {
+        Stage stage;
+        size_t index;
+        size_t key;
+        Node** bucket;
+        Node* node;
+        string_view id;
+        size_t probes;
+    };
+
+    results.assign(keys.size(), BidRef());
+    // Buckets must not move while lanes hold pointers into them
+    rehashStep(REHASH_STEP);
+
+    Lane lanes[BATCH_LANES];
+    size_t next = 0;
+    size_t active = 0;
+    auto start = [&](Lane& lane) {
+        if (next == keys.size()) {
+            lane.stage = DONE;
+            return;
+        }
+        lane.index = next++;
+        lane.key = hasher(keys[lane.index]);
+        lane.bucket = findBucket(lane.key);
+        lane.probes = 0;
+        lane.stage = BUCKET;
+        prefetchRead(lane.bucket);
+        active++;
+    };
+    auto visit = [&](Lane& lane, Node* node) {
+        if (node == nullptr) {
+            searchStats.Record(lane.probes, false);
+            active--;
+            start(lane);
+            return;
+        }
+        lane.node = node;
+        lane.stage = NODE;
+        prefetchRead(node);
+    };
+
+    for (Lane& lane : lanes) {
+        start(lane);
+    }
+    while (active > 0) {
+        for (Lane& lane : lanes) {
+            switch (lane.stage) {
+            case BUCKET:
+                visit(lane, *lane.bucket);
+                break;
+            case NODE:
+                lane.probes++;
+                if (lane.node->key == lane.key) {
+                    store->PrefetchBidId(lane.node->row);
+                    lane.stage = ROW;
+                }
+                else {
+                    visit(lane, lane.node->next);
+                }
+                break;
+            case ROW:
+                lane.id = store->BidId(lane.node->row);
+                prefetchRead(lane.id.data());
+                lane.stage = KEY;
+                break;
+            case KEY:
+                if (lane.id == keys[lane.index]) {
+                    results[lane.index] = BidRef(store, lane.node->row);
+                    searchStats.Record(lane.probes, true);
+                    active--;
+                    start(lane);
+                }
+                else {
+                    visit(lane, lane.node->next);
+                }
+                break;
+            case DONE:
+                break;
             }
-            else {
-                currentNode->key = UINT_MAX;
-                currentNode->bid = Bid();
+        }
+    }
+}
+
+// JSON dump: load, chain lengths over every bucket (long chains mean a
+// weak hash), search probe counts and allocations
+template <typename Hasher, template <typename> class Allocator>
+void HashTable<Hasher, Allocator>::PrintStats(ostream& out) const {
+    Histogram chains;
+    unsigned int emptyBuckets = 0;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        size_t length = 0;
+        for (Node* currentNode = nodes[i]; currentNode != nullptr; currentNode = currentNode->next) {
+            length++;
+        }
+        chains.Record(length);
+        emptyBuckets += length == 0 ? 1 : 0;
+    }
+    for (unsigned int i = migrateIndex; i < oldNodes.size(); i++) {
+        size_t length = 0;
+        for (Node* currentNode = oldNodes[i]; currentNode != nullptr; currentNode = currentNode->next) {
+            length++;
+        }
+        chains.Record(length);
+    }
+
+    out << "{\"container\": \"hash_chained\", \"entries\": " << count << ", \"buckets\": " << tableSize
+        << ", \"load_factor\": " << loadFactor() << ", \"max_load_factor\": " << maxLoadFactor
+        << ", \"rehashing\": " << (isRehashing() ? "true" : "false") << ", \"empty_buckets\": " << emptyBuckets
+        << ", \"chain_length\": ";
+    chains.WriteJson(out);
+    out << ", \"search\": ";
+    searchStats.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, pool.Counters());
+    out << "}" << endl;
+}
+
+//============================================================================
+// Flat open-addressing hash table (Swiss table layout)
+//============================================================================
+
+// Every slot lives in one contiguous array. A parallel array of control bytes
+// holds 7 bits of each key's hash (or an EMPTY/DELETED marker) so a lookup
+// can test a whole group of 16 slots with one SIMD compare before touching
+// the store.
+template <typename Hasher = BidIdHasher>
+class FlatHashTable {
+
+private:
+    static constexpr int8_t CTRL_EMPTY = -128;   // 0b10000000
+    static constexpr int8_t CTRL_DELETED = -2;   // 0b11111110
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    struct Slot {
+        RowId row;
+        size_t hash;
+
+        Slot() {
+            row = NO_ROW;
+            hash = 0;
+        }
+    };
+
+    // One group of control bytes, matched all at once
+    struct ProbeGroup {
+#ifdef __SSE2__
+        __m128i ctrl;
+
+        explicit ProbeGroup(const int8_t* pos) {
+            ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        }
+
+        uint32_t Match(int8_t h2) const {
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+        }
+
+        uint32_t MatchEmpty() const {
+            return Match(CTRL_EMPTY);
+        }
+
+        // EMPTY and DELETED are the only control bytes with the sign bit set
+        uint32_t MatchEmptyOrDeleted() const {
+            return (uint32_t)_mm_movemask_epi8(ctrl);
+        }
+#else
+        const int8_t* ctrl;
+
+        explicit ProbeGroup(const int8_t* pos) {
+            ctrl = pos;
+        }
+
+        uint32_t Match(int8_t h2) const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; i++) {
+                if (ctrl[i] == h2) {
+                    mask |= 1u << i;
+                }
             }
+            return mask;
+        }
+
+        uint32_t MatchEmpty() const {
+            return Match(CTRL_EMPTY);
+        }
+
+        uint32_t MatchEmptyOrDeleted() const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; i++) {
+                if (ctrl[i] < 0) {
+                    mask |= 1u << i;
+                }
+            }
+            return mask;
+        }
+#endif
+    };
+
+    vector<Slot> slots;
+    vector<int8_t> ctrl;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t deleted = 0;
+    BidStore* store;
+    Hasher hasher;
+    SearchStats searchStats; // groups probed per Search
+    BidSecondaryIndex secondary; // fund and amount lookups over the same rows
+
+    static size_t lowestBit(uint32_t mask);
+    size_t hashKey(string_view bidId) const;
+    static size_t h1(size_t hash);
+    static int8_t h2(size_t hash);
+
+    size_t findSlot(string_view bidId, size_t hash, size_t* groupsProbed = nullptr) const;
+    size_t findInsertSlot(size_t hash) const;
+    void resize(size_t newCapacity);
+
+public:
+    FlatHashTable(BidStore* bidStore);
+    FlatHashTable(BidStore* bidStore, size_t size);
+    virtual ~FlatHashTable();
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
+    void PrintAll();
+    template <typename Visit>
+    void ForEach(Visit visit);
+    void Remove(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    BidSecondaryIndex::FundRange SearchFund(string_view fund) const;
+    BidSecondaryIndex::AmountRange SearchAmount(double low, double high) const;
+    void reserve(size_t n);
+    void PrintStats(ostream& out) const;
+};
+
+template <typename Hasher>
+FlatHashTable<Hasher>::FlatHashTable(BidStore* bidStore) : secondary(bidStore) {
+    store = bidStore;
+    resize(MIN_CAPACITY);
+}
+
+template <typename Hasher>
+FlatHashTable<Hasher>::FlatHashTable(BidStore* bidStore, size_t size) : secondary(bidStore) {
+    store = bidStore;
+    resize(MIN_CAPACITY);
+    reserve(size);
+}
+
+template <typename Hasher>
+FlatHashTable<Hasher>::~FlatHashTable() {
+    slots.clear();
+    ctrl.clear();
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::reserve(size_t n) {
+    // Keep the table at most 7/8 full for the expected number of bids
+    size_t wanted = capacity;
+    while (wanted - wanted / 8 < n) {
+        wanted *= 2;
+    }
+    if (wanted > capacity) {
+        resize(wanted);
+    }
+}
+
+template <typename Hasher>
+size_t FlatHashTable<Hasher>::lowestBit(uint32_t mask) {
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctz(mask);
+#else
+    size_t bit = 0;
+    while ((mask & 1u) == 0) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+template <typename Hasher>
+size_t FlatHashTable<Hasher>::hashKey(string_view bidId) const {
+    return hasher(bidId);
+}
+
+// Upper bits pick the starting group
+template <typename Hasher>
+size_t FlatHashTable<Hasher>::h1(size_t hash) {
+    return hash >> 7;
+}
+
+// Lower 7 bits are stored in the control byte
+template <typename Hasher>
+int8_t FlatHashTable<Hasher>::h2(size_t hash) {
+    return (int8_t)(hash & 0x7F);
+}
+
+template <typename Hasher>
+size_t FlatHashTable<Hasher>::findSlot(string_view bidId, size_t hash, size_t* groupsProbed) const {
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    size_t group = h1(hash) & groupMask;
+
+    // Triangular probing over groups visits every group exactly once
+    for (size_t step = 1; step <= groupMask + 1; step++) {
+        if (groupsProbed != nullptr) {
+            *groupsProbed = step;
+        }
+        size_t base = group * GROUP_WIDTH;
+        ProbeGroup probe(&ctrl[base]);
+
+        uint32_t match = probe.Match(h2(hash));
+        while (match != 0) {
+            size_t index = base + lowestBit(match);
+            if (slots[index].hash == hash && store->BidId(slots[index].row) == bidId) {
+                return index;
+            }
+            match &= match - 1;
+        }
+
+        // An empty slot ends the probe sequence
+        if (probe.MatchEmpty() != 0) {
+            break;
+        }
+        group = (group + step) & groupMask;
+    }
+
+    return capacity;
+}
+
+template <typename Hasher>
+size_t FlatHashTable<Hasher>::findInsertSlot(size_t hash) const {
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    size_t group = h1(hash) & groupMask;
+
+    for (size_t step = 1; step <= groupMask + 1; step++) {
+        size_t base = group * GROUP_WIDTH;
+        uint32_t free = ProbeGroup(&ctrl[base]).MatchEmptyOrDeleted();
+        if (free != 0) {
+            return base + lowestBit(free);
+        }
+        group = (group + step) & groupMask;
+    }
+
+    return capacity;
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::resize(size_t newCapacity) {
+    vector<Slot> oldSlots;
+    vector<int8_t> oldCtrl;
+    oldSlots.swap(slots);
+    oldCtrl.swap(ctrl);
+
+    capacity = newCapacity;
+    slots.resize(capacity);
+    ctrl.assign(capacity, CTRL_EMPTY);
+    size = 0;
+    deleted = 0;
+
+    for (size_t i = 0; i < oldCtrl.size(); i++) {
+        if (oldCtrl[i] >= 0) {
+            size_t index = findInsertSlot(oldSlots[i].hash);
+            slots[index] = oldSlots[i];
+            ctrl[index] = h2(oldSlots[i].hash);
+            size++;
+        }
+    }
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::InsertRow(RowId row) {
+    string_view bidId = store->BidId(row);
+    size_t hash = hashKey(bidId);
+
+    // An existing bid with the same id is replaced in place
+    size_t index = findSlot(bidId, hash);
+    if (index != capacity) {
+        secondary.Remove(slots[index].row);
+        slots[index].row = row;
+        secondary.Add(row);
+        return;
+    }
+
+    // Grow (or just purge tombstones) before passing 7/8 full
+    if ((size + deleted + 1) > capacity - capacity / 8) {
+        resize(size + 1 > capacity / 2 ? capacity * 2 : capacity);
+    }
+
+    index = findInsertSlot(hash);
+    if (ctrl[index] == CTRL_DELETED) {
+        deleted--;
+    }
+    slots[index].row = row;
+    slots[index].hash = hash;
+    ctrl[index] = h2(hash);
+    size++;
+    secondary.Add(row);
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::PrintAll() {
+    BidExporter out(cout);
+    ForEach([&](BidRef bid) { out.Write(bid); });
+}
+
+template <typename Hasher>
+template <typename Visit>
+void FlatHashTable<Hasher>::ForEach(Visit visit) {
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] >= 0) {
+            visit(BidRef(store, slots[i].row));
+        }
+    }
+}
+
+template <typename Hasher>
+void FlatHashTable<Hasher>::Remove(string bidId) {
+    size_t index = findSlot(bidId, hashKey(bidId));
+    if (index == capacity) {
+        return;
+    }
+
+    // If this group still has an empty slot no probe sequence ever ran past
+    // it, so the slot can go straight back to EMPTY instead of a tombstone
+    size_t base = index - index % GROUP_WIDTH;
+    if (ProbeGroup(&ctrl[base]).MatchEmpty() != 0) {
+        ctrl[index] = CTRL_EMPTY;
+    }
+    else {
+        ctrl[index] = CTRL_DELETED;
+        deleted++;
+    }
+    secondary.Remove(slots[index].row);
+    slots[index].row = NO_ROW;
+    size--;
+}
+
+template <typename Hasher>
+BidSecondaryIndex::FundRange FlatHashTable<Hasher>::SearchFund(string_view fund) const {
+    return secondary.Fund(fund);
+}
+
+template <typename Hasher>
+BidSecondaryIndex::AmountRange FlatHashTable<Hasher>::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high);
+}
+
+template <typename Hasher>
+BidRef FlatHashTable<Hasher>::Search(string bidId) {
+    size_t groups = 0;
+    size_t index = findSlot(bidId, hashKey(bidId), &groups);
+    searchStats.Record(groups, index != capacity);
+    if (index == capacity) {
+        return BidRef();
+    }
+    return BidRef(store, slots[index].row);
+}
+
+// Group prefetching: hash BATCH_LANES keys and prefetch each home group's
+// control bytes and slots, then probe them. By the time the second pass
+// reaches a key its group is usually in cache; only the id compare and
+// the rare second group still miss.
+template <typename Hasher>
+void FlatHashTable<Hasher>::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    results.assign(keys.size(), BidRef());
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    size_t hashes[BATCH_LANES];
+
+    for (size_t first = 0; first < keys.size(); first += BATCH_LANES) {
+        size_t last = min(keys.size(), first + BATCH_LANES);
+        for (size_t i = first; i < last; i++) {
+            hashes[i - first] = hashKey(keys[i]);
+            size_t base = (h1(hashes[i - first]) & groupMask) * GROUP_WIDTH;
+            prefetchRead(&ctrl[base]);
+            prefetchRead(&slots[base]);
+        }
+        for (size_t i = first; i < last; i++) {
+            size_t groups = 0;
+            size_t index = findSlot(keys[i], hashes[i - first], &groups);
+            searchStats.Record(groups, index != capacity);
+            if (index != capacity) {
+                results[i] = BidRef(store, slots[index].row);
+            }
+        }
+    }
+}
+
+// JSON dump: fill, tombstones, and how many groups each stored bid sits
+// past its home group (what a successful lookup for it has to probe)
+template <typename Hasher>
+void FlatHashTable<Hasher>::PrintStats(ostream& out) const {
+    Histogram displacement;
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] < 0) {
+            continue;
+        }
+        size_t group = h1(slots[i].hash) & groupMask;
+        size_t step = 1;
+        while (group != i / GROUP_WIDTH && step <= groupMask) {
+            group = (group + step) & groupMask;
+            step++;
+        }
+        displacement.Record(step);
+    }
+
+    out << "{\"container\": \"hash_flat\", \"entries\": " << size << ", \"capacity\": " << capacity
+        << ", \"load_factor\": " << (capacity == 0 ? 0.0 : (double)size / capacity) << ", \"tombstones\": " << deleted
+        << ", \"groups_from_home\": ";
+    displacement.WriteJson(out);
+    out << ", \"search\": ";
+    searchStats.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, AllocationCounters());
+    out << "}" << endl;
+}
+
+//============================================================================
+// Concurrent hash table
+//============================================================================
+
+// Epoch-based reclamation. Readers pin the global epoch for the length of
+// a lookup; a removed node is only freed once the epoch has advanced twice
+// past the point it was retired, so no pinned reader can still see it.
+class EpochManager {
+
+private:
+    static constexpr unsigned int MAX_THREADS = 128;
+
+    struct alignas(64) ThreadSlot {
+        atomic<uint64_t> epoch{ 0 }; // 0 means not inside a read
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        void* pointer;
+        void (*deleter)(void*);
+    };
+
+    atomic<uint64_t> globalEpoch{ 1 };
+    ThreadSlot threads[MAX_THREADS];
+    mutex retireLock;
+    vector<Retired> retired;
+
+    static unsigned int threadIndex();
+    bool tryAdvance();
+
+public:
+    class Guard {
+    private:
+        ThreadSlot& slot;
+
+    public:
+        Guard(EpochManager& manager);
+        ~Guard();
+    };
+
+    virtual ~EpochManager();
+    void Retire(void* pointer, void (*deleter)(void*));
+    void Reclaim();
+};
+
+// Each live thread owns a slot until it exits. Two threads sharing one
+// would overwrite each other's pinned epoch, freeing nodes a reader still
+// holds, so a thread beyond MAX_THREADS aborts instead.
+unsigned int EpochManager::threadIndex() {
+    static atomic<bool> taken[MAX_THREADS];
+
+    struct Claim {
+        unsigned int index = 0;
+
+        Claim() {
+            for (; index < MAX_THREADS; index++) {
+                bool expected = false;
+                if (taken[index].compare_exchange_strong(expected, true)) {
+                    return;
+                }
+            }
+            cerr << "EpochManager: more than " << MAX_THREADS << " threads at once" << endl;
+            abort();
+        }
+
+        ~Claim() {
+            taken[index].store(false, memory_order_release);
+        }
+    };
+
+    thread_local Claim claim;
+    return claim.index;
+}
+
+EpochManager::Guard::Guard(EpochManager& manager) : slot(manager.threads[threadIndex()]) {
+    slot.epoch.store(manager.globalEpoch.load(memory_order_acquire), memory_order_seq_cst);
+}
+
+EpochManager::Guard::~Guard() {
+    slot.epoch.store(0, memory_order_release);
+}
+
+EpochManager::~EpochManager() {
+    for (const Retired& r : retired) {
+        r.deleter(r.pointer);
+    }
+    retired.clear();
+}
+
+// The epoch only moves once every reader has seen the current one
+bool EpochManager::tryAdvance() {
+    uint64_t current = globalEpoch.load(memory_order_acquire);
+    for (unsigned int i = 0; i < MAX_THREADS; i++) {
+        uint64_t seen = threads[i].epoch.load(memory_order_acquire);
+        if (seen != 0 && seen != current) {
+            return false;
+        }
+    }
+    return globalEpoch.compare_exchange_strong(current, current + 1);
+}
+
+void EpochManager::Retire(void* pointer, void (*deleter)(void*)) {
+    lock_guard<mutex> lock(retireLock);
+    retired.push_back({ globalEpoch.load(memory_order_acquire), pointer, deleter });
+    if (retired.size() >= 64) {
+        tryAdvance();
+    }
+}
+
+void EpochManager::Reclaim() {
+    lock_guard<mutex> lock(retireLock);
+    tryAdvance();
+    uint64_t safe = globalEpoch.load(memory_order_acquire);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++) {
+        if (retired[i].epoch + 2 <= safe) {
+            retired[i].deleter(retired[i].pointer);
         }
         else {
-            previousNode->next = currentNode->next;
-            delete currentNode;
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+}
+
+// Searches are lock-free: they walk immutable nodes through atomic links
+// under an epoch guard. Insert and Remove lock one of LOCK_STRIPES mutexes,
+// so writers to different stripes never wait on each other. The bucket
+// count is fixed once bids are loaded; size it with reserve().
+template <typename Hasher = BidIdHasher>
+class ConcurrentHashTable {
+
+private:
+    static constexpr unsigned int LOCK_STRIPES = 64;
+
+    struct Node {
+        const RowId row;
+        const size_t key;
+        atomic<Node*> next;
+
+        Node(RowId aRow, size_t aKey) : row(aRow), key(aKey), next(nullptr) {
+        }
+    };
+
+    struct alignas(64) Stripe {
+        mutable mutex lock; // queries of the secondary index take it too
+    };
+
+    unique_ptr<atomic<Node*>[]> nodes;
+    unsigned int tableSize = 0;
+    atomic<unsigned int> count{ 0 };
+    Stripe stripes[LOCK_STRIPES];
+    EpochManager epochs;
+    BidStore* store;
+    Hasher hasher;
+    // Shard key % LOCK_STRIPES is only updated under the stripe lock of the
+    // rows it holds: keys sharing a shard share a bucket's low bits, hence a
+    // stripe, and the shard stays put when reserve() rehashes
+    ShardedBidIndex secondary;
+
+    unsigned int hash(size_t key) const;
+    unique_lock<mutex> lockShard(size_t shard) const;
+    void allocate(unsigned int size);
+    void freeAll();
+    static void deleteNode(void* node);
+
+public:
+    ConcurrentHashTable(BidStore* bidStore);
+    ConcurrentHashTable(BidStore* bidStore, unsigned int size);
+    virtual ~ConcurrentHashTable();
+    void Insert(const Bid& bid);
+    void InsertRow(RowId row);
+    void PrintAll();
+    template <typename Visit>
+    void ForEach(Visit visit);
+    void Remove(string bidId);
+    BidRef Search(string bidId);
+    void SearchBatch(const vector<string_view>& keys, vector<BidRef>& results);
+    ShardedBidIndex::FundRange SearchFund(string_view fund) const;
+    ShardedBidIndex::AmountRange SearchAmount(double low, double high) const;
+    void reserve(unsigned int n);
+    void PrintStats(ostream& out);
+};
+
+template <typename Hasher>
+ConcurrentHashTable<Hasher>::ConcurrentHashTable(BidStore* bidStore) : secondary(bidStore, LOCK_STRIPES) {
+    store = bidStore;
+    allocate(DEFAULT_SIZE);
+}
+
+template <typename Hasher>
+ConcurrentHashTable<Hasher>::ConcurrentHashTable(BidStore* bidStore, unsigned int size) : secondary(bidStore, LOCK_STRIPES) {
+    store = bidStore;
+    allocate(size);
+}
+
+template <typename Hasher>
+ConcurrentHashTable<Hasher>::~ConcurrentHashTable() {
+    freeAll();
+}
+
+template <typename Hasher>
+unsigned int ConcurrentHashTable<Hasher>::hash(size_t key) const {
+    return (unsigned int)(key & (tableSize - 1));
+}
+
+// The stripe a secondary shard's keys lock: their buckets all end in the
+// shard's low bits, and LOCK_STRIPES divides any larger table size
+template <typename Hasher>
+unique_lock<mutex> ConcurrentHashTable<Hasher>::lockShard(size_t shard) const {
+    return unique_lock<mutex>(stripes[hash(shard) % LOCK_STRIPES].lock);
+}
+
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::allocate(unsigned int size) {
+    tableSize = 1;
+    while (tableSize < size) {
+        tableSize <<= 1;
+    }
+    nodes.reset(new atomic<Node*>[tableSize]);
+    for (unsigned int i = 0; i < tableSize; i++) {
+        nodes[i].store(nullptr, memory_order_relaxed);
+    }
+}
+
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::freeAll() {
+    for (unsigned int i = 0; i < tableSize; i++) {
+        Node* currentNode = nodes[i].load(memory_order_relaxed);
+        while (currentNode != nullptr) {
+            Node* temp = currentNode;
+            currentNode = currentNode->next.load(memory_order_relaxed);
+            delete temp;
+        }
+        nodes[i].store(nullptr, memory_order_relaxed);
+    }
+    count.store(0);
+}
+
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::deleteNode(void* node) {
+    delete static_cast<Node*>(node);
+}
+
+// Not thread-safe: call before the table is shared between threads
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::reserve(unsigned int n) {
+    if (n <= tableSize) {
+        return;
+    }
+
+    unique_ptr<atomic<Node*>[]> oldNodes(nodes.release());
+    unsigned int oldTableSize = tableSize;
+    allocate(n);
+
+    for (unsigned int i = 0; i < oldTableSize; i++) {
+        Node* currentNode = oldNodes[i].load(memory_order_relaxed);
+        while (currentNode != nullptr) {
+            Node* next = currentNode->next.load(memory_order_relaxed);
+            atomic<Node*>& bucket = nodes[hash(currentNode->key)];
+            currentNode->next.store(bucket.load(memory_order_relaxed), memory_order_relaxed);
+            bucket.store(currentNode, memory_order_relaxed);
+            currentNode = next;
+        }
+    }
+}
+
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::Insert(const Bid& bid) {
+    InsertRow(store->Append(bid));
+}
+
+// The store's append is itself thread-safe, so loaders may call Insert
+// from several threads. Nodes are immutable, so replacing a bid publishes
+// the new node before unlinking the old one: a reader sees one or the
+// other, never neither.
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::InsertRow(RowId row) {
+    string_view bidId = store->BidId(row);
+    size_t key = hasher(bidId);
+    unsigned int bucket = hash(key);
+    Node* node = new Node(row, key);
+    Node* replaced = nullptr;
+
+    {
+        lock_guard<mutex> lock(stripes[bucket % LOCK_STRIPES].lock);
+        node->next.store(nodes[bucket].load(memory_order_relaxed), memory_order_relaxed);
+        // Release publishes the fully built node to readers
+        nodes[bucket].store(node, memory_order_release);
+
+        atomic<Node*>* link = &node->next;
+        Node* currentNode = link->load(memory_order_relaxed);
+        while (currentNode != nullptr && (currentNode->key != key || store->BidId(currentNode->row) != bidId)) {
+            link = &currentNode->next;
+            currentNode = link->load(memory_order_relaxed);
+        }
+
+        if (currentNode != nullptr) {
+            link->store(currentNode->next.load(memory_order_relaxed), memory_order_release);
+            replaced = currentNode;
+        }
+        else {
+            count.fetch_add(1, memory_order_relaxed);
+        }
+        BidSecondaryIndex& shard = secondary.Shard(key % LOCK_STRIPES);
+        if (replaced != nullptr) {
+            shard.Remove(replaced->row);
+        }
+        shard.Add(row);
+    }
+
+    if (replaced != nullptr) {
+        epochs.Retire(replaced, deleteNode);
+        epochs.Reclaim();
+    }
+}
+
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::PrintAll() {
+    BidExporter out(cout);
+    ForEach([&](BidRef bid) { out.Write(bid); });
+}
+
+// Runs under an epoch guard, so nodes removed meanwhile stay readable
+template <typename Hasher>
+template <typename Visit>
+void ConcurrentHashTable<Hasher>::ForEach(Visit visit) {
+    EpochManager::Guard guard(epochs);
+    for (unsigned int i = 0; i < tableSize; i++) {
+        Node* currentNode = nodes[i].load(memory_order_acquire);
+        while (currentNode != nullptr) {
+            visit(BidRef(store, currentNode->row));
+            currentNode = currentNode->next.load(memory_order_acquire);
+        }
+    }
+}
+
+// JSON dump of the chains. Searches are not counted here: a shared
+// counter written by every reader would serialize the lock-free path.
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::PrintStats(ostream& out) {
+    EpochManager::Guard guard(epochs);
+    Histogram chains;
+    unsigned int emptyBuckets = 0;
+    for (unsigned int i = 0; i < tableSize; i++) {
+        size_t length = 0;
+        for (Node* currentNode = nodes[i].load(memory_order_acquire); currentNode != nullptr; currentNode = currentNode->next.load(memory_order_acquire)) {
+            length++;
         }
+        chains.Record(length);
+        emptyBuckets += length == 0 ? 1 : 0;
     }
+
+    unsigned int entries = count.load();
+    out << "{\"container\": \"hash_concurrent\", \"entries\": " << entries << ", \"buckets\": " << tableSize
+        << ", \"load_factor\": " << (tableSize == 0 ? 0.0 : (double)entries / tableSize) << ", \"lock_stripes\": " << LOCK_STRIPES
+        << ", \"empty_buckets\": " << emptyBuckets << ", \"chain_length\": ";
+    chains.WriteJson(out);
+    out << ", \"allocations\": ";
+    writeAllocationJson(out, AllocationCounters());
+    out << "}" << endl;
 }
 
-Bid HashTable::Search(string bidId) {
-    Bid bid;
-    unsigned int key = hash(stoi(bidId));
-    Node* currentNode = &nodes[key];
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::Remove(string bidId) {
+    size_t key = hasher(bidId);
+    unsigned int bucket = hash(key);
+    Node* removed = nullptr;
 
+    {
+        lock_guard<mutex> lock(stripes[bucket % LOCK_STRIPES].lock);
+        atomic<Node*>* link = &nodes[bucket];
+        Node* currentNode = link->load(memory_order_relaxed);
+        while (currentNode != nullptr && (currentNode->key != key || store->BidId(currentNode->row) != bidId)) {
+            link = &currentNode->next;
+            currentNode = link->load(memory_order_relaxed);
+        }
+
+        if (currentNode != nullptr) {
+            // Readers already on this node keep following its next link
+            link->store(currentNode->next.load(memory_order_relaxed), memory_order_release);
+            removed = currentNode;
+            count.fetch_sub(1, memory_order_relaxed);
+            secondary.Shard(key % LOCK_STRIPES).Remove(removed->row);
+        }
+    }
+
+    if (removed != nullptr) {
+        epochs.Retire(removed, deleteNode);
+        epochs.Reclaim();
+    }
+}
+
+template <typename Hasher>
+BidRef ConcurrentHashTable<Hasher>::Search(string bidId) {
+    size_t key = hasher(bidId);
+    EpochManager::Guard guard(epochs);
+
+    Node* currentNode = nodes[hash(key)].load(memory_order_acquire);
     while (currentNode != nullptr) {
-        if (currentNode->bid.bidId == bidId) {
-            return currentNode->bid;
+        if (currentNode->key == key && store->BidId(currentNode->row) == bidId) {
+            return BidRef(store, currentNode->row);
         }
-        currentNode = currentNode->next;
+        currentNode = currentNode->next.load(memory_order_acquire);
     }
 
-    return bid;
+    return BidRef();
 }
 
-void loadBids(string csvPath, HashTable* hashTable) {
-    cout << "Loading CSV file " << csvPath << endl;
+// The secondary indexes are not lock-free: a query locks one stripe at a
+// time while it copies out that shard's matches, so it may run beside
+// writers and other queries, and sees each shard as of when it got there
+template <typename Hasher>
+ShardedBidIndex::FundRange ConcurrentHashTable<Hasher>::SearchFund(string_view fund) const {
+    return secondary.Fund(fund, [this](size_t shard) { return lockShard(shard); });
+}
 
-    csv::Parser file = csv::Parser(csvPath);
-    vector<string> header = file.getHeader();
+template <typename Hasher>
+ShardedBidIndex::AmountRange ConcurrentHashTable<Hasher>::SearchAmount(double low, double high) const {
+    return secondary.Amount(low, high, [this](size_t shard) { return lockShard(shard); });
+}
 
-    try {
-        for (unsigned int i = 0; i < file.rowCount(); i++) {
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
+// Group prefetching under one epoch guard: prefetch BATCH_LANES buckets,
+// then walk their chains
+template <typename Hasher>
+void ConcurrentHashTable<Hasher>::SearchBatch(const vector<string_view>& keys, vector<BidRef>& results) {
+    results.assign(keys.size(), BidRef());
+    EpochManager::Guard guard(epochs);
+    size_t hashes[BATCH_LANES];
 
-            hashTable->Insert(bid);
+    for (size_t first = 0; first < keys.size(); first += BATCH_LANES) {
+        size_t last = min(keys.size(), first + BATCH_LANES);
+        for (size_t i = first; i < last; i++) {
+            hashes[i - first] = hasher(keys[i]);
+            prefetchRead(&nodes[hash(hashes[i - first])]);
+        }
+        for (size_t i = first; i < last; i++) {
+            size_t key = hashes[i - first];
+            Node* currentNode = nodes[hash(key)].load(memory_order_acquire);
+            while (currentNode != nullptr) {
+                if (currentNode->key == key && store->BidId(currentNode->row) == keys[i]) {
+                    results[i] = BidRef(store, currentNode->row);
+                    break;
+                }
+                currentNode = currentNode->next.load(memory_order_acquire);
+            }
         }
     }
-    catch (csv::Error& e) {
-        cerr << e.what() << endl;
+}
+
+// Appends the CSV's bids to the store, sizes the table once for all of
+// them and indexes their rows
+template <typename Table>
+LoadTimings loadBids(string csvPath, BidStore* store, Table* hashTable) {
+    LoadTimings timings;
+    vector<RowId> rows = loadBidCsv(csvPath, store, timings);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    hashTable->reserve((unsigned int)rows.size());
+    for (RowId row : rows) {
+        hashTable->InsertRow(row);
     }
+    timings.buildSeconds += secondsSince(start);
+
+    return timings;
 }
 
-double strToDouble(string str, char ch) {
-    str.erase(remove(str.begin(), str.end(), ch), str.end());
-    return atof(str.c_str());
+// Loads keys into a HashTable<Hasher> and returns the average time of a
+// Search over them, so every hasher runs through the same table code
+template <typename Hasher>
+double timeHasherSearches(const vector<string>& keys, unsigned int rounds, size_t& found) {
+    BidStore store;
+    HashTable<Hasher> table(&store);
+    table.reserve((unsigned int)keys.size());
+    for (const string& key : keys) {
+        table.InsertRow(store.Append(key, "", "General Fund", 0.0));
+    }
+
+    clock_t ticks = clock();
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (const string& key : keys) {
+            found += table.Search(key).valid();
+        }
+    }
+    ticks = clock() - ticks;
+    return ticks * 1e9 / CLOCKS_PER_SEC / ((double)keys.size() * rounds);
 }
 
-int main(int argc, char* argv[]) {
-    string csvPath, bidKey;
-    switch (argc) {
-    case 2:
-        csvPath = argv[1];
-        bidKey = "98223";
-        break;
-    case 3:
-        csvPath = argv[1];
-        bidKey = argv[2];
-        break;
-    default:
-        csvPath = "eBid_Monthly_Sales.csv";
-        bidKey = "98223";
+// Times searches with the original key (stoi of the id) against
+// BidIdHasher, both in HashTable over the same bid ids
+void benchmarkHashers(unsigned int keyCount, unsigned int rounds) {
+    vector<string> keys;
+    keys.reserve(keyCount);
+    for (unsigned int i = 0; i < keyCount; i++) {
+        keys.push_back(to_string(10000 + (i * 7919u) % 900000u));
+    }
+
+    size_t found = 0;
+    double legacyNs = timeHasherSearches<LegacyIntHasher>(keys, rounds, found);
+    double byteNs = timeHasherSearches<BidIdHasher>(keys, rounds, found);
+    cout << "LegacyIntHasher: " << legacyNs << " ns/search" << endl;
+    cout << "BidIdHasher:     " << byteNs << " ns/search" << endl;
+    cout << "(found " << found << ")" << endl;
+}
+
+// Runs 1..N reader threads against a ConcurrentHashTable while one writer
+// keeps inserting and removing, and reports searches per second. Wall-clock
+// time is used because clock() adds up CPU time across threads. The
+// writer's bids are appended to the store once up front and then cycled,
+// since the store never frees rows.
+void benchmarkConcurrent(unsigned int keyCount, unsigned int milliseconds) {
+    BidStore store;
+    ConcurrentHashTable<> table(&store);
+    table.reserve(keyCount * 2);
+
+    vector<string> keys;
+    keys.reserve(keyCount);
+    for (unsigned int i = 0; i < keyCount; i++) {
+        Bid bid;
+        bid.bidId = to_string(100000 + i);
+        bid.title = "Bid " + bid.bidId;
+        bid.fund = "General Fund";
+        bid.amount = i;
+        keys.push_back(bid.bidId);
+        table.Insert(bid);
+    }
+
+    vector<RowId> churnRows;
+    vector<string> churnKeys;
+    churnRows.reserve(keyCount);
+    churnKeys.reserve(keyCount);
+    for (unsigned int i = 0; i < keyCount; i++) {
+        string bidId = to_string(900000000 + i);
+        churnRows.push_back(store.Append(bidId, "Bid " + bidId, "Enterprise", i));
+        churnKeys.push_back(bidId);
     }
 
+    unsigned int maxThreads = max(1u, thread::hardware_concurrency());
+    for (unsigned int readers = 1; ; readers = min(readers * 2, maxThreads)) {
+        atomic<bool> stop{ false };
+        atomic<uint64_t> searches{ 0 };
+
+        thread writer([&]() {
+            unsigned int next = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                table.InsertRow(churnRows[next]);
+                table.Remove(churnKeys[next]);
+                next = next + 1 == keyCount ? 0 : next + 1;
+            }
+        });
+
+        vector<thread> workers;
+        for (unsigned int t = 0; t < readers; t++) {
+            workers.emplace_back([&, t]() {
+                uint64_t done = 0;
+                unsigned int index = t * 7919u;
+                while (!stop.load(memory_order_relaxed)) {
+                    if (table.Search(keys[index % keyCount]).valid()) {
+                        done++;
+                    }
+                    index += 104729u;
+                }
+                searches.fetch_add(done);
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::milliseconds(milliseconds));
+        stop.store(true);
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        writer.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << readers << " reader thread(s): " << (uint64_t)(searches.load() / seconds) << " searches/sec" << endl;
+        if (readers == maxThreads) {
+            break;
+        }
+    }
+}
+
+template <typename Table>
+int runMenu(string csvPath, string bidKey) {
     clock_t ticks;
-    HashTable* bidTable = new HashTable();
-    Bid bid;
+    BidStore store;
+    Table* bidTable = new Table(&store);
+    BidRef bid;
+    RowId firstRow;
+    vector<TraceEvent> events;
+    string tracePath;
+
+    // Set BID_TRACE to record every menu operation for later replay
+    TraceWriter trace;
+    openTraceFromEnvironment(trace);
 
     int choice = 0;
     while (choice != 9) {
@@ -226,28 +1553,46 @@ int main(int argc, char* argv[]) {
         cout << "  2. Display All Bids" << endl;
         cout << "  3. Find Bid" << endl;
         cout << "  4. Remove Bid" << endl;
+        cout << "  5. Benchmark Hash Functions" << endl;
+        cout << "  6. Benchmark Concurrent Searches" << endl;
+        cout << "  7. Replay Trace" << endl;
+        cout << "  8. Stats" << endl;
         cout << "  9. Exit" << endl;
+        cout << " 10. Export Bids" << endl;
+        cout << " 11. Save Snapshot" << endl;
+        cout << " 12. Load Snapshot" << endl;
+        cout << " 13. Find Bids by Fund" << endl;
+        cout << " 14. Find Bids by Amount" << endl;
+        cout << " 15. Search Snapshot" << endl;
         cout << "Enter choice: ";
         cin >> choice;
 
         switch (choice) {
         case 1:
             ticks = clock();
-            loadBids(csvPath, bidTable);
+            firstRow = (RowId)store.Size();
+            printLoadTimings(loadBids(csvPath, &store, bidTable));
             ticks = clock() - ticks;
+            if (trace.IsOpen()) {
+                for (RowId row = firstRow; row < store.Size(); row++) {
+                    trace.Insert(BidRef(&store, row));
+                }
+            }
             cout << "time: " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
             break;
 
         case 2:
+            trace.Print();
             bidTable->PrintAll();
             break;
 
         case 3:
+            trace.Search(bidKey);
             ticks = clock();
             bid = bidTable->Search(bidKey);
             ticks = clock() - ticks;
-            if (!bid.bidId.empty()) {
+            if (bid.valid()) {
                 displayBid(bid);
             }
             else {
@@ -258,8 +1603,76 @@ int main(int argc, char* argv[]) {
             break;
 
         case 4:
+            trace.Remove(bidKey);
             bidTable->Remove(bidKey);
             break;
+
+        case 5:
+            benchmarkHashers(1000000, 10);
+            break;
+
+        case 6:
+            benchmarkConcurrent(1000000, 500);
+            break;
+
+        // Replays against the current table, so load first to replay on
+        // top of the CSV bids
+        case 7:
+            cout << "Enter trace file: ";
+            cin >> tracePath;
+            if (readTrace(tracePath, events)) {
+                printReplayStats(replayTrace(events, *bidTable, [](Table& table) { table.PrintAll(); }));
+            }
+            events.clear();
+            break;
+
+        case 8:
+            bidTable->PrintStats(cout);
+            break;
+
+        case 10:
+            exportFromMenu([&](auto write) { bidTable->ForEach(write); });
+            break;
+
+        case 11: {
+            vector<RowId> rows;
+            bidTable->ForEach([&](BidRef saved) { rows.push_back(saved.row); });
+            ticks = clock();
+            if (saveSnapshot(promptSnapshotPath(), "hash", store, rows)) {
+                ticks = clock() - ticks;
+                cout << rows.size() << " bids saved" << endl;
+                cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            }
+            break;
+        }
+
+        // Adds the snapshot's bids to whatever is loaded, as Load Bids does
+        case 12:
+            firstRow = (RowId)store.Size();
+            loadSnapshot(promptSnapshotPath(), store, [&](vector<RowId>& rows, vector<RowId>&) {
+                bidTable->reserve((unsigned int)rows.size());
+                for (RowId row : rows) {
+                    bidTable->InsertRow(row);
+                }
+            });
+            if (trace.IsOpen()) {
+                for (RowId row = firstRow; row < store.Size(); row++) {
+                    trace.Insert(BidRef(&store, row));
+                }
+            }
+            break;
+
+        case 13:
+            fundQueryFromMenu([&](const string& fund) { return bidTable->SearchFund(fund); });
+            break;
+
+        case 14:
+            amountQueryFromMenu([&](double low, double high) { return bidTable->SearchAmount(low, high); });
+            break;
+
+        case 15:
+            searchSnapshotFromMenu();
+            break;
         }
     }
 
@@ -267,3 +1680,35 @@ int main(int argc, char* argv[]) {
     delete bidTable;
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    string csvPath, bidKey, engine;
+    switch (argc) {
+    case 2:
+        csvPath = argv[1];
+        bidKey = "98223";
+        break;
+    case 3:
+        csvPath = argv[1];
+        bidKey = argv[2];
+        break;
+    case 4:
+        csvPath = argv[1];
+        bidKey = argv[2];
+        engine = argv[3];
+        break;
+    default:
+        csvPath = "eBid_Monthly_Sales.csv";
+        bidKey = "98223";
+    }
+
+    // "flat" selects the open-addressing table, "concurrent" the thread-safe
+    // one, anything else the chained one
+    if (engine == "flat") {
+        return runMenu<FlatHashTable<>>(csvPath, bidKey);
+    }
+    if (engine == "concurrent") {
+        return runMenu<ConcurrentHashTable<>>(csvPath, bidKey);
+    }
+    return runMenu<HashTable<>>(csvPath, bidKey);
+}
\ No newline at end of file
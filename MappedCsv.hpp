@@ -0,0 +1,461 @@
+//============================================================================
+// Name        : MappedCsv.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Zero-copy CSV reader over a memory-mapped file
+//============================================================================
+
+#ifndef MAPPEDCSV_HPP
+#define MAPPEDCSV_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "BidStore.hpp"
+
+// Read-only mapping of a whole file
+class MappedFile {
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    virtual ~MappedFile() {
+        Close();
+    }
+
+    bool Open(const std::string& path) {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = (size_t)fileSize.QuadPart;
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (data == nullptr) {
+                Close();
+                return false;
+            }
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = (size_t)info.st_size;
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            madvise(mapped, length, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapped);
+        }
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+#endif
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), length);
+        }
+#endif
+        data = nullptr;
+        length = 0;
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + length;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// One parsed row. Fields are views into the mapped file; a quoted field
+// is returned without its surrounding quotes, but doubled quotes inside it
+// are left as-is (see csvFieldToString).
+struct CsvRow {
+    std::vector<std::string_view> fields;
+
+    size_t size() const {
+        return fields.size();
+    }
+
+    std::string_view operator[](size_t i) const {
+        return fields[i];
+    }
+};
+
+// Splits [begin, end) into rows and fields in place, without copying.
+// Handles quoted fields (including commas and newlines inside quotes) and
+// both \n and \r\n line endings.
+class CsvReader {
+
+private:
+    const char* pos;
+    const char* end;
+
+public:
+    CsvReader(const char* begin, const char* finish) {
+        pos = begin;
+        end = finish;
+    }
+
+    // Start of the next unread row; after NextRow() the previous value up
+    // to this one spans the raw text of the row just returned
+    const char* Position() const {
+        return pos;
+    }
+
+    bool NextRow(CsvRow& row) {
+        row.fields.clear();
+        if (pos >= end) {
+            return false;
+        }
+
+        while (true) {
+            const char* fieldStart = pos;
+            const char* fieldEnd;
+
+            if (pos < end && *pos == '"') {
+                // Quoted: scan to the closing quote, stepping over ""
+                fieldStart = ++pos;
+                while (pos < end) {
+                    if (*pos == '"') {
+                        if (pos + 1 < end && pos[1] == '"') {
+                            pos += 2;
+                            continue;
+                        }
+                        break;
+                    }
+                    pos++;
+                }
+                fieldEnd = pos;
+                if (pos < end) {
+                    pos++; // closing quote
+                }
+                while (pos < end && *pos != ',' && *pos != '\n') {
+                    pos++;
+                }
+            }
+            else {
+                while (pos < end && *pos != ',' && *pos != '\n') {
+                    pos++;
+                }
+                fieldEnd = pos;
+                if (fieldEnd > fieldStart && fieldEnd[-1] == '\r' && (pos == end || *pos == '\n')) {
+                    fieldEnd--;
+                }
+            }
+
+            row.fields.emplace_back(fieldStart, (size_t)(fieldEnd - fieldStart));
+
+            if (pos >= end) {
+                return true;
+            }
+            if (*pos++ == '\n') {
+                return true;
+            }
+        }
+    }
+};
+
+// Upper bound on the number of rows, for presizing containers
+inline size_t countCsvLines(const char* begin, const char* end) {
+    size_t lines = 0;
+    const char* pos = begin;
+    while (pos < end) {
+        const void* newline = memchr(pos, '\n', (size_t)(end - pos));
+        lines++;
+        if (newline == nullptr) {
+            break;
+        }
+        pos = static_cast<const char*>(newline) + 1;
+    }
+    return lines;
+}
+
+// Copies a field out of the mapping, collapsing "" escapes
+inline std::string csvFieldToString(std::string_view field) {
+    if (field.find('"') == std::string_view::npos) {
+        return std::string(field);
+    }
+    std::string value;
+    value.reserve(field.size());
+    for (size_t i = 0; i < field.size(); i++) {
+        value += field[i];
+        if (field[i] == '"' && i + 1 < field.size() && field[i + 1] == '"') {
+            i++;
+        }
+    }
+    return value;
+}
+
+// Parses a number out of a field, skipping every occurrence of ch
+// (e.g. the '$' in front of bid amounts)
+inline double csvFieldToDouble(std::string_view field, char ch) {
+    char buffer[64];
+    size_t length = 0;
+    for (char c : field) {
+        if (c != ch && length < sizeof(buffer) - 1) {
+            buffer[length++] = c;
+        }
+    }
+    buffer[length] = '\0';
+    return atof(buffer);
+}
+
+//============================================================================
+// Parallel loading
+//============================================================================
+
+// Wall-clock time spent in each stage of a load, in seconds
+struct LoadTimings {
+    double mapSeconds = 0.0;
+    double parseSeconds = 0.0;
+    double buildSeconds = 0.0;
+    size_t rows = 0;
+    unsigned int threads = 1;
+};
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Cuts the data rows (everything after the header line) into about
+// `parts` ranges that each start at the beginning of a row. A newline only
+// counts as a row boundary when it is outside quotes, which is tracked by
+// counting quote characters between candidate cut points.
+inline std::vector<std::pair<const char*, const char*>> splitCsvRows(const char* begin, const char* end, unsigned int parts) {
+    std::vector<std::pair<const char*, const char*>> chunks;
+
+    // Skip the header row
+    const char* start = begin;
+    bool inQuotes = false;
+    while (start < end && (*start != '\n' || inQuotes)) {
+        if (*start == '"') {
+            inQuotes = !inQuotes;
+        }
+        start++;
+    }
+    if (start < end) {
+        start++;
+    }
+
+    size_t target = std::max<size_t>(1, (size_t)(end - start) / std::max(1u, parts));
+    const char* chunkStart = start;
+    const char* scanned = start;
+    size_t quotes = 0;
+
+    while (chunkStart < end) {
+        const char* cut = std::min(end, chunkStart + target);
+        while (cut < end) {
+            const char* newline = static_cast<const char*>(memchr(cut, '\n', (size_t)(end - cut)));
+            if (newline == nullptr) {
+                cut = end;
+                break;
+            }
+            quotes += (size_t)std::count(scanned, newline, '"');
+            scanned = newline;
+            cut = newline + 1;
+            if (quotes % 2 == 0) {
+                break;
+            }
+        }
+        chunks.emplace_back(chunkStart, cut);
+        chunkStart = cut;
+    }
+
+    return chunks;
+}
+
+// Parses the rows of every chunk on its own thread. addRow(row, batch)
+// adds one CsvRow to the chunk's batch, which is presized for lineCount
+// rows. Batches come back in file order, one per chunk.
+template <typename Batch, typename AddRow>
+std::vector<Batch> parseCsvParallel(const MappedFile& file, unsigned int threads, AddRow addRow) {
+    std::vector<std::pair<const char*, const char*>> chunks = splitCsvRows(file.begin(), file.end(), threads);
+    std::vector<Batch> batches(chunks.size());
+    std::vector<std::thread> workers;
+
+    for (size_t c = 0; c < chunks.size(); c++) {
+        workers.emplace_back([&, c]() {
+            CsvReader reader(chunks[c].first, chunks[c].second);
+            CsvRow row;
+            Batch& batch = batches[c];
+            batch.Reserve(countCsvLines(chunks[c].first, chunks[c].second));
+            while (reader.NextRow(row)) {
+                addRow(row, batch);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return batches;
+}
+
+inline unsigned int loaderThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//============================================================================
+// Bid CSV loading shared by the labs
+//============================================================================
+
+// The four columns a bid keeps from each row of one chunk, as views into
+// the mapped file. Only a field with "" escapes is copied, collapsed into
+// text the batch owns, so the store's append is the one full copy.
+struct BidCsvBatch {
+    struct Row {
+        std::string_view bidId;
+        std::string_view title;
+        std::string_view fund;
+        double amount;
+    };
+
+    std::vector<Row> rows;
+    std::deque<std::string> unescaped; // deque, so views into it stay put
+
+    void Reserve(size_t lines) {
+        rows.reserve(lines);
+    }
+
+    std::string_view Field(std::string_view field) {
+        if (field.find('"') == std::string_view::npos) {
+            return field;
+        }
+        unescaped.push_back(csvFieldToString(field));
+        return unescaped.back();
+    }
+};
+
+// Picks the bid columns out of a row; rows too short to hold them are skipped
+inline void rowToBid(const CsvRow& row, BidCsvBatch& batch) {
+    if (row.size() <= 8) {
+        return;
+    }
+    batch.rows.push_back({ batch.Field(row[1]), batch.Field(row[0]), batch.Field(row[8]), csvFieldToDouble(row[4], '$') });
+}
+
+// Maps csvPath, parses it on every core and appends its bids to store in
+// file order, returning their rows. Writes the header's column names to
+// header when one is given. Fills in the map and parse times; buildSeconds
+// covers the append, and callers add the time to build their container.
+inline std::vector<RowId> loadBidCsv(const std::string& csvPath, BidStore* store, LoadTimings& timings, std::ostream* header = nullptr) {
+    std::cout << "Loading CSV file " << csvPath << std::endl;
+    std::vector<RowId> rows;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.Open(csvPath)) {
+        std::cerr << "Unable to open " << csvPath << std::endl;
+        return rows;
+    }
+    timings.mapSeconds = secondsSince(start);
+
+    if (header != nullptr) {
+        CsvReader reader(file.begin(), file.end());
+        CsvRow row;
+        reader.NextRow(row);
+        for (std::string_view column : row.fields) {
+            *header << column << " | ";
+        }
+        *header << "" << std::endl;
+    }
+
+    // Rows are parsed on every core, one chunk of the file per thread
+    start = std::chrono::steady_clock::now();
+    timings.threads = loaderThreads();
+    std::vector<BidCsvBatch> batches = parseCsvParallel<BidCsvBatch>(file, timings.threads, rowToBid);
+    timings.parseSeconds = secondsSince(start);
+
+    // Copy each batch into the store, freeing it as soon as it is in
+    start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (const BidCsvBatch& batch : batches) {
+        total += batch.rows.size();
+    }
+    rows.reserve(total);
+    for (BidCsvBatch& batch : batches) {
+        for (const BidCsvBatch::Row& row : batch.rows) {
+            rows.push_back(store->Append(row.bidId, row.title, row.fund, row.amount));
+        }
+        batch = BidCsvBatch();
+    }
+    timings.rows = total;
+    timings.buildSeconds = secondsSince(start);
+
+    return rows;
+}
+
+inline void printLoadTimings(const LoadTimings& timings) {
+    std::cout << timings.rows << " bids read on " << timings.threads << " thread(s)" << std::endl;
+    std::cout << "  map:   " << timings.mapSeconds << " seconds" << std::endl;
+    std::cout << "  parse: " << timings.parseSeconds << " seconds" << std::endl;
+    std::cout << "  build: " << timings.buildSeconds << " seconds" << std::endl;
+}
+
+#endif // MAPPEDCSV_HPP
@@ -0,0 +1,154 @@
+//============================================================================
+// Name        : NodePool.hpp
+// Author      : Nneka Hamilton
+// Version     : 1.0
+// Description : Slab allocators for HashTable and BinarySearchTree nodes
+//============================================================================
+
+#ifndef NODEPOOL_HPP
+#define NODEPOOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Counters shared by every node allocator
+struct AllocationCounters {
+    size_t allocations = 0;   // nodes handed out
+    size_t deallocations = 0; // nodes given back one at a time
+    size_t systemAllocations = 0; // calls that reached operator new
+    size_t bytesReserved = 0;
+
+    size_t liveNodes() const {
+        return allocations - deallocations;
+    }
+};
+
+// Hands out nodes from large contiguous slabs. Destroy() puts a node on a
+// free list for the next Create(); Release() gives every slab back at once.
+// For trivially destructible nodes Release() only frees the slabs; other
+// nodes are destroyed in one sequential pass over the slabs, which is still
+// far cheaper than chasing container links to delete them one by one.
+template <typename T>
+class NodePool {
+
+private:
+    static const size_t SLAB_NODES = 1024;
+
+    struct Slot {
+        union {
+            Slot* nextFree;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+        bool live;
+    };
+
+    std::vector<Slot*> slabs;
+    size_t slabUsed = SLAB_NODES;
+    Slot* freeList = nullptr;
+    AllocationCounters counters;
+
+    Slot* takeSlot() {
+        if (freeList != nullptr) {
+            Slot* slot = freeList;
+            freeList = slot->nextFree;
+            return slot;
+        }
+        if (slabUsed == SLAB_NODES) {
+            slabs.push_back(static_cast<Slot*>(::operator new(sizeof(Slot) * SLAB_NODES)));
+            slabUsed = 0;
+            counters.systemAllocations++;
+            counters.bytesReserved += sizeof(Slot) * SLAB_NODES;
+        }
+        return &slabs.back()[slabUsed++];
+    }
+
+public:
+    static const bool BULK_RELEASE = true;
+
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    virtual ~NodePool() {
+        Release();
+    }
+
+    template <typename... Args>
+    T* Create(Args&&... args) {
+        Slot* slot = takeSlot();
+        T* node = new (slot->storage) T(std::forward<Args>(args)...);
+        slot->live = true;
+        counters.allocations++;
+        return node;
+    }
+
+    void Destroy(T* node) {
+        Slot* slot = reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(node) - offsetof(Slot, storage));
+        node->~T();
+        slot->live = false;
+        slot->nextFree = freeList;
+        freeList = slot;
+        counters.deallocations++;
+    }
+
+    void Release() {
+        for (size_t s = 0; s < slabs.size(); s++) {
+            if (!std::is_trivially_destructible<T>::value) {
+                size_t used = (s + 1 == slabs.size()) ? slabUsed : SLAB_NODES;
+                for (size_t i = 0; i < used; i++) {
+                    if (slabs[s][i].live) {
+                        reinterpret_cast<T*>(slabs[s][i].storage)->~T();
+                    }
+                }
+            }
+            ::operator delete(slabs[s]);
+        }
+        counters.deallocations = counters.allocations;
+        counters.bytesReserved = 0;
+        slabs.clear();
+        slabUsed = SLAB_NODES;
+        freeList = nullptr;
+    }
+
+    const AllocationCounters& Counters() const {
+        return counters;
+    }
+};
+
+// Plain new/delete behind the same interface, kept for comparison. It has
+// no way to release in bulk, so containers still free nodes one at a time.
+template <typename T>
+class HeapAllocator {
+
+private:
+    AllocationCounters counters;
+
+public:
+    static const bool BULK_RELEASE = false;
+
+    template <typename... Args>
+    T* Create(Args&&... args) {
+        counters.allocations++;
+        counters.systemAllocations++;
+        counters.bytesReserved += sizeof(T);
+        return new T(std::forward<Args>(args)...);
+    }
+
+    void Destroy(T* node) {
+        counters.deallocations++;
+        counters.bytesReserved -= sizeof(T);
+        delete node;
+    }
+
+    void Release() {
+    }
+
+    const AllocationCounters& Counters() const {
+        return counters;
+    }
+};
+
+#endif // NODEPOOL_HPP
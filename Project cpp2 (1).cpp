@@ -2,83 +2,799 @@
 //
 
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Every distinct course id in a file, each stored once and numbered in
+// order of first appearance. The names sit end to end in one string and
+// are found through an open-addressing table of symbol numbers, so the
+// table holds three flat arrays however many ids it interns.
+class CourseSymbols {
+
+private:
+    std::string text;                       // every name, end to end
+    std::vector<uint32_t> offsets = { 0 };  // symbol i is text[offsets[i], offsets[i + 1])
+    std::vector<int> slots;                 // symbol numbers, -1 if empty; a power of two long
+
+    size_t slotFor(std::string_view name) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = std::hash<std::string_view>()(name) & mask;
+        while (slots[slot] >= 0 && Name(slots[slot]) != name) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void grow() {
+        std::vector<int> old(std::max<size_t>(16, slots.size() * 2), -1);
+        old.swap(slots);
+        for (int symbol : old) {
+            if (symbol >= 0) {
+                slots[slotFor(Name(symbol))] = symbol;
+            }
+        }
+    }
+
+public:
+    // Symbol number for name, adding it if it is new
+    int Intern(std::string_view name) {
+        if ((Size() + 1) * 2 > slots.size()) {
+            grow();
+        }
+        size_t slot = slotFor(name);
+        if (slots[slot] < 0) {
+            text.append(name.data(), name.size());
+            offsets.push_back((uint32_t)text.size());
+            slots[slot] = (int)Size() - 1;
+        }
+        return slots[slot];
+    }
+
+    // Symbol number for name, or -1 if it was never interned
+    int Find(std::string_view name) const {
+        if (slots.empty()) {
+            return -1;
+        }
+        return slots[slotFor(name)];
+    }
+
+    std::string_view Name(int symbol) const {
+        return std::string_view(text).substr(offsets[symbol], offsets[symbol + 1] - offsets[symbol]);
+    }
+
+    size_t Size() const {
+        return offsets.size() - 1;
+    }
+
+    size_t MemoryBytes() const {
+        return sizeof(*this) + text.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(int);
+    }
+};
 
 // Struct to represent a course
 struct Course {
     std::string courseId;
     std::string courseTitle;
-    std::vector<std::string> prerequisites;
+    int symbol = -1;                // courseId in the symbol table, -1 if the line has none
+    std::vector<int> prerequisites; // symbol numbers of the prerequisite ids
+    int line = 0;                   // line in the course file, for validation reports
 };
 
-// Function to read course data from file and store in a vector
-std::vector<Course> readCourseData(const std::string& filename) {
-    std::vector<Course> courses; // Vector to store course objects
-    // Open the file
-    std::ifstream file(filename);
-    // Check if the file is opened successfully
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    // Read each line from the file
-    std::string line;
-    while (std::getline(file, line)) {
-        // Use stringstream to parse the line into course attributes
-        std::stringstream ss(line);
+// Course files are read this many bytes at a time; a longer line grows the buffer
+const size_t PARSE_BUFFER_BYTES = 1 << 16;
+
+// Function to read course data from file into courses, interning every id
+// into symbols. The file is read a block at a time and each line is split
+// in place; only the id and title are copied out. Blank lines are skipped
+// and a trailing \r is dropped. Returns false with a message in error if
+// the file cannot be opened or read, leaving the outputs to be discarded.
+bool readCourseData(const std::string& filename, std::vector<Course>& courses, CourseSymbols& symbols, std::string& error) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        error = "Error opening file: " + filename + " (" + strerror(errno) + ")";
+        return false;
+    }
+
+    // Assuming courseId, courseTitle, and prerequisites are separated by commas
+    auto parseLine = [&](const char* begin, const char* end, int lineNumber) {
+        if (end > begin && end[-1] == '\r') {
+            end--;
+        }
+        if (end == begin) {
+            return;
+        }
+        const char* comma = (const char*)memchr(begin, ',', end - begin);
+        const char* idEnd = comma != nullptr ? comma : end;
         Course course;
-        // Assuming courseId, courseTitle, and prerequisites are separated by commas
-        std::getline(ss, course.courseId, ',');
-        std::getline(ss, course.courseTitle, ',');
-        // Read prerequisites and split
-        std::string prerequisite;
-        while (std::getline(ss, prerequisite, ',')) {
-            course.prerequisites.push_back(prerequisite);
+        course.line = lineNumber;
+        course.courseId.assign(begin, idEnd);
+        if (idEnd > begin) {
+            course.symbol = symbols.Intern(std::string_view(begin, idEnd - begin));
+        }
+        if (comma != nullptr) {
+            const char* title = comma + 1;
+            comma = (const char*)memchr(title, ',', end - title);
+            course.courseTitle.assign(title, comma != nullptr ? comma : end);
+            // Each prerequisite up to the next comma; a comma ending the line adds nothing
+            while (comma != nullptr && comma + 1 < end) {
+                const char* field = comma + 1;
+                comma = (const char*)memchr(field, ',', end - field);
+                const char* fieldEnd = comma != nullptr ? comma : end;
+                course.prerequisites.push_back(symbols.Intern(std::string_view(field, fieldEnd - field)));
+            }
+        }
+        courses.push_back(std::move(course));
+    };
+
+    std::vector<char> buffer(PARSE_BUFFER_BYTES);
+    size_t filled = 0;
+    int lineNumber = 0;
+    bool atEnd = false;
+    while (!atEnd) {
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        size_t got = fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+        filled += got;
+        atEnd = got == 0;
+        if (atEnd && ferror(file)) {
+            error = "Error reading file: " + filename;
+            fclose(file);
+            return false;
         }
-        // Add the course to the vector
-        courses.push_back(course);
+
+        // Every complete line, then the unterminated last one at end of file
+        const char* start = buffer.data();
+        const char* stop = buffer.data() + filled;
+        for (const char* newline; (newline = (const char*)memchr(start, '\n', stop - start)) != nullptr; start = newline + 1) {
+            parseLine(start, newline, ++lineNumber);
+        }
+        if (atEnd && start < stop) {
+            parseLine(start, stop, ++lineNumber);
+            start = stop;
+        }
+        filled = stop - start;
+        memmove(buffer.data(), start, filled);
     }
-    // Close the file
-    file.close();
-    return courses;
+    fclose(file);
+    return true;
 }
 
-// Function to print course list in alphanumeric order
-void printAlphanumericCourseList(const std::vector<Course>& courses) {
-    std::vector<Course> sortedCourses = courses;
-    // Sort the courses alphanumerically based on courseId
-    std::sort(sortedCourses.begin(), sortedCourses.end(), [](const Course& a, const Course& b) {
-        return a.courseId < b.courseId;
+// Radix tree over course ids: every edge carries a compressed run of
+// characters, so a catalog of ids sharing department prefixes stays small.
+// Nodes live in one array and refer to each other by position. A node's
+// children start as a short sorted list of first bytes and switch to a
+// direct 256-slot table once there are more than NARROW_FANOUT of them.
+// Child order is byte order, which is std::string's order, so a depth-first
+// walk visits ids already sorted.
+class CourseRadixTree {
+public:
+    static const size_t NARROW_FANOUT = 16;
+
+private:
+    struct Node {
+        std::string label;               // characters on the edge into this node
+        int course = -1;                 // course whose id ends here
+        bool wide = false;
+        std::vector<unsigned char> keys; // narrow: first byte of each child's label, sorted
+        std::vector<int> children;       // narrow: parallel to keys; wide: 256 slots, -1 if empty
+    };
+
+    std::vector<Node> nodes = std::vector<Node>(1); // nodes[0] is the root, with an empty label
+    size_t count = 0;
+
+    int findChild(int node, unsigned char c) const {
+        const Node& n = nodes[node];
+        if (n.wide) {
+            return n.children[c];
+        }
+        for (size_t i = 0; i < n.keys.size() && n.keys[i] <= c; i++) {
+            if (n.keys[i] == c) {
+                return n.children[i];
+            }
+        }
+        return -1;
+    }
+
+    void setChild(int node, unsigned char c, int child) {
+        Node& n = nodes[node];
+        if (n.wide) {
+            n.children[c] = child;
+            return;
+        }
+        size_t i = std::lower_bound(n.keys.begin(), n.keys.end(), c) - n.keys.begin();
+        if (i < n.keys.size() && n.keys[i] == c) {
+            n.children[i] = child;
+            return;
+        }
+        if (n.keys.size() < NARROW_FANOUT) {
+            n.keys.insert(n.keys.begin() + i, c);
+            n.children.insert(n.children.begin() + i, child);
+            return;
+        }
+        std::vector<int> slots(256, -1);
+        for (size_t k = 0; k < n.keys.size(); k++) {
+            slots[n.keys[k]] = n.children[k];
+        }
+        slots[c] = child;
+        n.children.swap(slots);
+        std::vector<unsigned char>().swap(n.keys);
+        n.wide = true;
+    }
+
+    int newNode(std::string label, int course) {
+        nodes.emplace_back();
+        nodes.back().label = std::move(label);
+        nodes.back().course = course;
+        return (int)nodes.size() - 1;
+    }
+
+    // Visits every course under node in id order, without recursion
+    template <typename Visit>
+    void visitSubtree(int node, Visit visit) const {
+        std::vector<int> stack(1, node);
+        while (!stack.empty()) {
+            const Node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (n.course >= 0) {
+                visit(n.course);
+            }
+            for (size_t i = n.children.size(); i-- > 0;) {
+                if (n.children[i] >= 0) {
+                    stack.push_back(n.children[i]);
+                }
+            }
+        }
+    }
+
+public:
+    // Adds a course id; false if the id is already present (the first
+    // course with an id keeps it)
+    bool Insert(const std::string& courseId, int course) {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < courseId.size()) {
+            unsigned char c = (unsigned char)courseId[pos];
+            int child = findChild(node, c);
+            if (child < 0) {
+                int leaf = newNode(courseId.substr(pos), course);
+                setChild(node, c, leaf);
+                count++;
+                return true;
+            }
+            const std::string& label = nodes[child].label;
+            size_t common = 1;
+            while (common < label.size() && pos + common < courseId.size() && label[common] == courseId[pos + common]) {
+                common++;
+            }
+            if (common < label.size()) {
+                // Split the edge: a new node takes the shared characters
+                int middle = newNode(nodes[child].label.substr(0, common), -1);
+                nodes[child].label.erase(0, common);
+                setChild(middle, (unsigned char)nodes[child].label[0], child);
+                setChild(node, c, middle);
+                child = middle;
+            }
+            node = child;
+            pos += common;
+        }
+        if (nodes[node].course >= 0) {
+            return false;
+        }
+        nodes[node].course = course;
+        count++;
+        return true;
+    }
+
+    // Course with exactly this id, or -1
+    int Find(const std::string& courseId) const {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < courseId.size()) {
+            node = findChild(node, (unsigned char)courseId[pos]);
+            if (node < 0 || courseId.compare(pos, nodes[node].label.size(), nodes[node].label) != 0) {
+                return -1;
+            }
+            pos += nodes[node].label.size();
+        }
+        return nodes[node].course;
+    }
+
+    // Visits every course in id order
+    template <typename Visit>
+    void ForEach(Visit visit) const {
+        visitSubtree(0, visit);
+    }
+
+    // Visits, in id order, every course whose id starts with prefix
+    template <typename Visit>
+    void ForEachPrefix(const std::string& prefix, Visit visit) const {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < prefix.size()) {
+            node = findChild(node, (unsigned char)prefix[pos]);
+            if (node < 0) {
+                return;
+            }
+            const std::string& label = nodes[node].label;
+            size_t length = std::min(label.size(), prefix.size() - pos);
+            if (label.compare(0, length, prefix, pos, length) != 0) {
+                return;
+            }
+            pos += length;
+        }
+        visitSubtree(node, visit);
+    }
+
+    size_t Size() const {
+        return count;
+    }
+
+    size_t NodeCount() const {
+        return nodes.size();
+    }
+
+    size_t WideNodeCount() const {
+        size_t wide = 0;
+        for (const Node& n : nodes) {
+            wide += n.wide ? 1 : 0;
+        }
+        return wide;
+    }
+
+    // Bytes held by the tree: the node array plus the child lists and any
+    // label too long for std::string's inline buffer
+    size_t MemoryBytes() const {
+        size_t bytes = sizeof(*this) + nodes.capacity() * sizeof(Node);
+        for (const Node& n : nodes) {
+            const char* inlineStart = reinterpret_cast<const char*>(&n.label);
+            if (n.label.data() < inlineStart || n.label.data() >= inlineStart + sizeof(n.label)) {
+                bytes += n.label.capacity() + 1;
+            }
+            bytes += n.keys.capacity() + n.children.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+};
+
+// Dense prerequisite closures are kept only while they fit in this many
+// bytes (about 45,000 courses); larger catalogs fill a course's row on demand
+const size_t CLOSURE_BUDGET_BYTES = 256u << 20;
+
+// Courses compiled for queries: an id index, prerequisites as integer
+// course numbers, a topological order and the transitive closure of every
+// course's prerequisites as one bitset row per course
+struct CourseCatalog {
+    std::vector<Course> courses;
+    CourseSymbols symbols;                      // every id in the file, hashed
+    std::vector<int> courseOfSymbol;            // symbol -> position in courses, -1 if no course
+    CourseRadixTree ordered;                    // the same ids, in order and by prefix
+    std::vector<int> prerequisiteStart;         // course i's prerequisites are prerequisiteIds
+    std::vector<int> prerequisiteIds;           //   [prerequisiteStart[i], prerequisiteStart[i + 1])
+    std::vector<int> topologicalOrder;          // every prerequisite before the courses needing it
+    std::vector<int> topologicalRank;           // position of each course in topologicalOrder
+    size_t closureWords = 0;                    // 64-bit words per closure row
+    std::vector<uint64_t> closure;              // empty when over CLOSURE_BUDGET_BYTES
+    size_t cyclicCourses = 0;                   // courses Kahn's algorithm could not order
+};
+
+// Function to find a course's position in the catalog, or -1
+int findCourse(const CourseCatalog& catalog, const std::string& courseId) {
+    int symbol = catalog.symbols.Find(courseId);
+    return symbol >= 0 ? catalog.courseOfSymbol[symbol] : -1;
+}
+
+// Function to compile the loaded courses: index the ids, resolve every
+// prerequisite to a course number, order the graph with Kahn's algorithm
+// and OR the closures together in that order. Prerequisites naming no
+// course are left out of the graph; courses on a cycle are appended to the
+// order afterwards, and their closures may be incomplete.
+CourseCatalog buildCourseCatalog(std::vector<Course> courses, CourseSymbols symbols) {
+    CourseCatalog catalog;
+    catalog.courses = std::move(courses);
+    catalog.symbols = std::move(symbols);
+    const int count = (int)catalog.courses.size();
+    catalog.courseOfSymbol.assign(catalog.symbols.Size(), -1);
+    for (int i = 0; i < count; i++) {
+        // A line without an id is reported by validation, not indexed
+        int symbol = catalog.courses[i].symbol;
+        if (symbol >= 0 && catalog.courseOfSymbol[symbol] < 0) {
+            catalog.courseOfSymbol[symbol] = i;
+            catalog.ordered.Insert(catalog.courses[i].courseId, i);
+        }
+    }
+
+    catalog.prerequisiteStart.assign(count + 1, 0);
+    for (int i = 0; i < count; i++) {
+        for (int prerequisite : catalog.courses[i].prerequisites) {
+            int id = catalog.courseOfSymbol[prerequisite];
+            if (id >= 0) {
+                catalog.prerequisiteIds.push_back(id);
+            }
+        }
+        catalog.prerequisiteStart[i + 1] = (int)catalog.prerequisiteIds.size();
+    }
+
+    // Reverse edges (prerequisite -> courses needing it) for Kahn's algorithm
+    std::vector<int> dependentStart(count + 1, 0);
+    std::vector<int> dependentIds(catalog.prerequisiteIds.size());
+    std::vector<int> waiting(count, 0);
+    for (int id : catalog.prerequisiteIds) {
+        dependentStart[id + 1]++;
+    }
+    for (int i = 0; i < count; i++) {
+        dependentStart[i + 1] += dependentStart[i];
+        waiting[i] = catalog.prerequisiteStart[i + 1] - catalog.prerequisiteStart[i];
+    }
+    std::vector<int> fill(dependentStart.begin(), dependentStart.end() - 1);
+    for (int i = 0; i < count; i++) {
+        for (int p = catalog.prerequisiteStart[i]; p < catalog.prerequisiteStart[i + 1]; p++) {
+            dependentIds[fill[catalog.prerequisiteIds[p]]++] = i;
+        }
+    }
+
+    catalog.topologicalOrder.reserve(count);
+    for (int i = 0; i < count; i++) {
+        if (waiting[i] == 0) {
+            catalog.topologicalOrder.push_back(i);
+        }
+    }
+    for (size_t next = 0; next < catalog.topologicalOrder.size(); next++) {
+        int course = catalog.topologicalOrder[next];
+        for (int d = dependentStart[course]; d < dependentStart[course + 1]; d++) {
+            if (--waiting[dependentIds[d]] == 0) {
+                catalog.topologicalOrder.push_back(dependentIds[d]);
+            }
+        }
+    }
+    catalog.cyclicCourses = count - catalog.topologicalOrder.size();
+    for (int i = 0; i < count && catalog.cyclicCourses > 0; i++) {
+        if (waiting[i] > 0) {
+            catalog.topologicalOrder.push_back(i);
+        }
+    }
+    catalog.topologicalRank.assign(count, 0);
+    for (int rank = 0; rank < count; rank++) {
+        catalog.topologicalRank[catalog.topologicalOrder[rank]] = rank;
+    }
+
+    // Each row is the OR of its prerequisites' rows plus their own bits;
+    // the order guarantees those rows are already complete
+    catalog.closureWords = (count + 63) / 64;
+    if ((double)count * catalog.closureWords * sizeof(uint64_t) <= CLOSURE_BUDGET_BYTES) {
+        catalog.closure.assign((size_t)count * catalog.closureWords, 0);
+        for (int course : catalog.topologicalOrder) {
+            uint64_t* row = &catalog.closure[(size_t)course * catalog.closureWords];
+            for (int p = catalog.prerequisiteStart[course]; p < catalog.prerequisiteStart[course + 1]; p++) {
+                int id = catalog.prerequisiteIds[p];
+                const uint64_t* prerequisiteRow = &catalog.closure[(size_t)id * catalog.closureWords];
+                for (size_t w = 0; w < catalog.closureWords; w++) {
+                    row[w] |= prerequisiteRow[w];
+                }
+                row[id / 64] |= 1ULL << (id % 64);
+            }
+        }
+    }
+    return catalog;
+}
+
+// Function to get a course's closure row: the precomputed one, or one
+// filled into scratch by walking the prerequisite graph
+const uint64_t* prerequisiteClosure(const CourseCatalog& catalog, int course, std::vector<uint64_t>& scratch) {
+    if (!catalog.closure.empty()) {
+        return &catalog.closure[(size_t)course * catalog.closureWords];
+    }
+    scratch.assign(catalog.closureWords, 0);
+    std::vector<int> stack(1, course);
+    while (!stack.empty()) {
+        int current = stack.back();
+        stack.pop_back();
+        for (int p = catalog.prerequisiteStart[current]; p < catalog.prerequisiteStart[current + 1]; p++) {
+            int id = catalog.prerequisiteIds[p];
+            if ((scratch[id / 64] & (1ULL << (id % 64))) == 0) {
+                scratch[id / 64] |= 1ULL << (id % 64);
+                stack.push_back(id);
+            }
+        }
+    }
+    return scratch.data();
+}
+
+// Function to find the lowest set bit of a nonzero word, one instruction
+// where the compiler exposes it
+inline int lowestSetBit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long bit;
+    _BitScanForward64(&bit, bits);
+    return (int)bit;
+#else
+    int bit = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Function to list the courses whose bits are set in row, in the order
+// they can be taken
+std::vector<int> coursesInRow(const CourseCatalog& catalog, const uint64_t* row) {
+    std::vector<int> result;
+    for (size_t w = 0; w < catalog.closureWords; w++) {
+        for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+            result.push_back((int)(w * 64 + lowestSetBit(bits)));
+        }
+    }
+    std::sort(result.begin(), result.end(), [&catalog](int a, int b) {
+        return catalog.topologicalRank[a] < catalog.topologicalRank[b];
         });
-    // Print the sorted list
+    return result;
+}
+
+// Function to list every direct and indirect prerequisite of a course
+std::vector<int> allPrerequisites(const CourseCatalog& catalog, int course) {
+    std::vector<uint64_t> scratch;
+    return coursesInRow(catalog, prerequisiteClosure(catalog, course, scratch));
+}
+
+// Function to check a course against the courses a student has completed:
+// the closure row minus the completed set, a word at a time. Returns the
+// prerequisites still missing, in the order they can be taken.
+std::vector<int> missingPrerequisites(const CourseCatalog& catalog, int course, const std::vector<int>& completed) {
+    std::vector<uint64_t> taken(catalog.closureWords, 0);
+    for (int id : completed) {
+        taken[id / 64] |= 1ULL << (id % 64);
+    }
+    std::vector<uint64_t> scratch;
+    const uint64_t* row = prerequisiteClosure(catalog, course, scratch);
+    std::vector<uint64_t> missing(catalog.closureWords);
+    for (size_t w = 0; w < catalog.closureWords; w++) {
+        missing[w] = row[w] & ~taken[w];
+    }
+    return coursesInRow(catalog, missing.data());
+}
+
+// Catalogs at least this large are validated on several threads
+const size_t PARALLEL_VALIDATION_COURSES = 50000;
+
+// Courses named in each cycle report; the rest are only counted
+const size_t CYCLE_MEMBERS_LISTED = 20;
+
+enum ProblemKind {
+    MALFORMED_LINE,       // no course id or no title
+    DUPLICATE_ID,         // a course id defined more than once
+    MISSING_PREREQUISITE, // a prerequisite naming no course
+    PREREQUISITE_CYCLE    // courses that (indirectly) require each other
+};
+
+// One problem found in the catalog, reported against the line defining it
+struct CatalogProblem {
+    ProblemKind kind;
+    int line;
+    std::string detail;
+};
+
+// Function to check courses [begin, end) on their own: fields present, id
+// not defined earlier, every prerequisite interned to an actual course
+void validateCourses(const CourseCatalog& catalog, size_t begin, size_t end, std::vector<CatalogProblem>& problems) {
+    for (size_t i = begin; i < end; i++) {
+        const Course& course = catalog.courses[i];
+        if (course.courseId.empty() || course.courseTitle.empty()) {
+            problems.push_back({ MALFORMED_LINE, course.line,
+                course.courseId.empty() ? "missing course id" : "course " + course.courseId + " has no title" });
+            if (course.courseId.empty()) {
+                continue;
+            }
+        }
+        int first = catalog.courseOfSymbol[course.symbol];
+        if (first != (int)i) {
+            problems.push_back({ DUPLICATE_ID, course.line,
+                "course " + course.courseId + " is already defined on line " + std::to_string(catalog.courses[first].line) });
+        }
+        for (int prerequisite : course.prerequisites) {
+            if (catalog.courseOfSymbol[prerequisite] < 0) {
+                std::string_view name = catalog.symbols.Name(prerequisite);
+                problems.push_back({ MISSING_PREREQUISITE, course.line,
+                    "course " + course.courseId + " requires unknown course " + (name.empty() ? "(empty)" : std::string(name)) });
+            }
+        }
+    }
+}
+
+// Function to find every prerequisite cycle: Tarjan's strongly connected
+// components over the compiled graph, with an explicit stack so long
+// chains cannot overflow the call stack. Each component of two or more
+// courses, or a course requiring itself, is one cycle.
+void findPrerequisiteCycles(const CourseCatalog& catalog, std::vector<CatalogProblem>& problems) {
+    const int count = (int)catalog.courses.size();
+    std::vector<int> order(count, -1); // discovery order, -1 until visited
+    std::vector<int> low(count, 0);
+    std::vector<bool> onStack(count, false);
+    std::vector<int> component;
+    std::vector<std::pair<int, int>> calls; // course and its next prerequisite edge
+    int visited = 0;
+
+    for (int root = 0; root < count; root++) {
+        if (order[root] >= 0) {
+            continue;
+        }
+        calls.push_back({ root, catalog.prerequisiteStart[root] });
+        order[root] = low[root] = visited++;
+        component.push_back(root);
+        onStack[root] = true;
+        while (!calls.empty()) {
+            int course = calls.back().first;
+            int& edge = calls.back().second;
+            if (edge < catalog.prerequisiteStart[course + 1]) {
+                int next = catalog.prerequisiteIds[edge++];
+                if (order[next] < 0) {
+                    calls.push_back({ next, catalog.prerequisiteStart[next] });
+                    order[next] = low[next] = visited++;
+                    component.push_back(next);
+                    onStack[next] = true;
+                }
+                else if (onStack[next]) {
+                    low[course] = std::min(low[course], order[next]);
+                }
+                continue;
+            }
+            calls.pop_back();
+            if (!calls.empty()) {
+                int parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[course]);
+            }
+            if (low[course] != order[course]) {
+                continue;
+            }
+            // course is the root of a component: everything above it on the stack
+            std::vector<int> members;
+            int member;
+            do {
+                member = component.back();
+                component.pop_back();
+                onStack[member] = false;
+                members.push_back(member);
+            } while (member != course);
+            bool requiresItself = false;
+            for (int p = catalog.prerequisiteStart[course]; p < catalog.prerequisiteStart[course + 1]; p++) {
+                requiresItself |= catalog.prerequisiteIds[p] == course;
+            }
+            if (members.size() < 2 && !requiresItself) {
+                continue;
+            }
+            std::sort(members.begin(), members.end(), [&catalog](int a, int b) {
+                return catalog.courses[a].courseId < catalog.courses[b].courseId;
+                });
+            std::string detail = "prerequisite cycle through " + std::to_string(members.size()) + " course" + (members.size() > 1 ? "s:" : ":");
+            for (size_t m = 0; m < members.size() && m < CYCLE_MEMBERS_LISTED; m++) {
+                detail += " " + catalog.courses[members[m]].courseId;
+            }
+            if (members.size() > CYCLE_MEMBERS_LISTED) {
+                detail += " and " + std::to_string(members.size() - CYCLE_MEMBERS_LISTED) + " more";
+            }
+            problems.push_back({ PREREQUISITE_CYCLE, catalog.courses[members[0]].line, detail });
+        }
+    }
+}
+
+// Function to validate a compiled catalog in one pass over its courses and
+// prerequisite graph, reporting every problem at once. Large catalogs are
+// split into a chunk per hardware thread for the per-course checks, with
+// the cycle search running alongside on its own thread.
+std::vector<CatalogProblem> validateCatalog(const CourseCatalog& catalog) {
+    const size_t count = catalog.courses.size();
+    size_t workers = 1;
+    if (count >= PARALLEL_VALIDATION_COURSES) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<std::vector<CatalogProblem>> found(workers);
+    std::vector<CatalogProblem> cycles;
+    if (workers == 1) {
+        validateCourses(catalog, 0, count, found[0]);
+        findPrerequisiteCycles(catalog, cycles);
+    }
+    else {
+        std::vector<std::thread> threads;
+        threads.emplace_back(findPrerequisiteCycles, std::cref(catalog), std::ref(cycles));
+        size_t chunk = (count + workers - 1) / workers;
+        for (size_t w = 0; w < workers; w++) {
+            size_t begin = std::min(count, w * chunk);
+            size_t end = std::min(count, begin + chunk);
+            threads.emplace_back(validateCourses, std::cref(catalog), begin, end, std::ref(found[w]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Chunks are in course order, so the report follows the file
+    std::vector<CatalogProblem> problems;
+    for (auto& chunkProblems : found) {
+        problems.insert(problems.end(), chunkProblems.begin(), chunkProblems.end());
+    }
+    problems.insert(problems.end(), cycles.begin(), cycles.end());
+    return problems;
+}
+
+// Function to print a validation report, one problem per line and then a
+// count of each kind
+void printValidationReport(const CourseCatalog& catalog, const std::vector<CatalogProblem>& problems, double seconds) {
+    static const char* const KIND_NAMES[] = { "malformed lines", "duplicate ids", "missing prerequisites", "prerequisite cycles" };
+    size_t counts[4] = {};
+    for (const auto& problem : problems) {
+        std::cout << "Line " << problem.line << ": " << problem.detail << std::endl;
+        counts[problem.kind]++;
+    }
+    std::cout << "Validated " << catalog.courses.size() << " courses in " << seconds << " seconds: ";
+    if (problems.empty()) {
+        std::cout << "no problems found." << std::endl;
+        return;
+    }
+    std::cout << problems.size() << " problems (";
+    for (int kind = 0; kind < 4; kind++) {
+        std::cout << (kind > 0 ? ", " : "") << counts[kind] << " " << KIND_NAMES[kind];
+    }
+    std::cout << ")." << std::endl;
+    if (catalog.cyclicCourses > 0) {
+        std::cout << catalog.cyclicCourses << " courses are on or depend on a cycle; their prerequisite lists may be incomplete." << std::endl;
+    }
+}
+
+// Function to print course list in alphanumeric order
+void printAlphanumericCourseList(const CourseCatalog& catalog) {
+    // The radix tree hands the courses over already sorted by courseId
     std::cout << "Alphanumeric Course List:" << std::endl;
-    for (const auto& course : sortedCourses) {
+    catalog.ordered.ForEach([&catalog](int id) {
+        const Course& course = catalog.courses[id];
         std::cout << "Course ID: " << course.courseId
             << ", Title: " << course.courseTitle << std::endl;
-    }
+        });
+}
+
+// Function to print every course whose id starts with prefix, in order
+void printCoursesWithPrefix(const CourseCatalog& catalog, const std::string& prefix) {
+    size_t matches = 0;
+    catalog.ordered.ForEachPrefix(prefix, [&catalog, &matches](int id) {
+        const Course& course = catalog.courses[id];
+        std::cout << "Course ID: " << course.courseId
+            << ", Title: " << course.courseTitle << std::endl;
+        matches++;
+        });
+    std::cout << matches << " courses start with " << prefix << std::endl;
 }
 
 // Function to print course information based on courseNumber
-void printCourseInformation(const std::vector<Course>& courses, const std::string& courseNumber) {
+void printCourseInformation(const CourseCatalog& catalog, const std::string& courseNumber) {
     // Find the course with the specified courseNumber
-    auto it = std::find_if(courses.begin(), courses.end(),
-        [courseNumber](const Course& course) {
-            return course.courseId == courseNumber;
-        });
+    int id = findCourse(catalog, courseNumber);
     // Check if the course is found
-    if (it != courses.end()) {
+    if (id >= 0) {
+        const Course& course = catalog.courses[id];
         // Print course information
-        std::cout << "Course ID: " << it->courseId
-            << ", Title: " << it->courseTitle << std::endl;
+        std::cout << "Course ID: " << course.courseId
+            << ", Title: " << course.courseTitle << std::endl;
         // Print prerequisites
-        if (!it->prerequisites.empty()) {
+        if (!course.prerequisites.empty()) {
             std::cout << "Prerequisites: ";
-            for (const auto& prerequisite : it->prerequisites) {
-                std::cout << prerequisite << " ";
+            for (int prerequisite : course.prerequisites) {
+                std::cout << catalog.symbols.Name(prerequisite) << " ";
             }
             std::cout << std::endl;
         }
@@ -91,8 +807,59 @@ void printCourseInformation(const std::vector<Course>& courses, const std::strin
     }
 }
 
+// Function to print every prerequisite of a course, in an order they can be taken
+void printAllPrerequisites(const CourseCatalog& catalog, const std::string& courseNumber) {
+    int id = findCourse(catalog, courseNumber);
+    if (id < 0) {
+        std::cerr << "Course not found with the specified ID: " << courseNumber << std::endl;
+        return;
+    }
+    std::vector<int> prerequisites = allPrerequisites(catalog, id);
+    if (prerequisites.empty()) {
+        std::cout << "No prerequisites for this course." << std::endl;
+        return;
+    }
+    std::cout << "All prerequisites of " << courseNumber << " (" << prerequisites.size() << "): ";
+    for (int prerequisite : prerequisites) {
+        std::cout << catalog.courses[prerequisite].courseId << " ";
+    }
+    std::cout << std::endl;
+}
+
+// Function to check whether a student who completed the comma-separated
+// courses in completedList can take a course
+void printEligibility(const CourseCatalog& catalog, const std::string& courseNumber, const std::string& completedList) {
+    int id = findCourse(catalog, courseNumber);
+    if (id < 0) {
+        std::cerr << "Course not found with the specified ID: " << courseNumber << std::endl;
+        return;
+    }
+    std::vector<int> completed;
+    std::stringstream ss(completedList);
+    std::string courseId;
+    while (std::getline(ss, courseId, ',')) {
+        int completedId = findCourse(catalog, courseId);
+        if (completedId >= 0) {
+            completed.push_back(completedId);
+        }
+        else if (!courseId.empty()) {
+            std::cerr << "Ignoring unknown course: " << courseId << std::endl;
+        }
+    }
+    std::vector<int> missing = missingPrerequisites(catalog, id, completed);
+    if (missing.empty()) {
+        std::cout << "All prerequisites met; the student can take " << courseNumber << "." << std::endl;
+        return;
+    }
+    std::cout << "Cannot take " << courseNumber << " yet. Missing: ";
+    for (int prerequisite : missing) {
+        std::cout << catalog.courses[prerequisite].courseId << " ";
+    }
+    std::cout << std::endl;
+}
+
 int main() {
-    std::vector<Course> courses; // Vector to store course objects
+    CourseCatalog catalog; // Courses, their id index and prerequisite graph
     while (true) {
         // Display menu options
         std::cout << "Welcome to the Course Planner" << std::endl;
@@ -100,10 +867,13 @@ int main() {
         std::cout << "1. Load Data Structure" << std::endl;
         std::cout << "2. Print Course List" << std::endl;
         std::cout << "3. Print Course Information" << std::endl;
-        std::cout << "4. Exit" << std::endl;
+        std::cout << "4. Print All Prerequisites" << std::endl;
+        std::cout << "5. Check Course Eligibility" << std::endl;
+        std::cout << "6. Search Courses by Prefix" << std::endl;
+        std::cout << "7. Exit" << std::endl;
 
         int choice;
-        std::cout << "Enter your choice (1-4): ";
+        std::cout << "Enter your choice (1-7): ";
         std::cin >> choice;
 
         switch (choice) {
@@ -111,35 +881,93 @@ int main() {
             std::string filename;
             std::cout << "Enter the file name containing course data: ";
             std::cin >> filename;
-            courses = readCourseData(filename);
+            std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+            std::vector<Course> courses;
+            CourseSymbols symbols;
+            std::string error;
+            if (!readCourseData(filename, courses, symbols, error)) {
+                // Keep whatever catalog was loaded before
+                std::cerr << error << std::endl;
+                break;
+            }
+            catalog = buildCourseCatalog(std::move(courses), std::move(symbols));
             std::cout << "Data loaded successfully." << std::endl;
+            std::cout << "Loaded " << catalog.courses.size() << " courses and " << catalog.symbols.Size() << " distinct ids ("
+                << catalog.symbols.MemoryBytes() << " bytes) in "
+                << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() << " seconds" << std::endl;
+            std::cout << "Course index: " << catalog.ordered.Size() << " ids in " << catalog.ordered.NodeCount()
+                << " radix nodes (" << catalog.ordered.WideNodeCount() << " wide), "
+                << catalog.ordered.MemoryBytes() << " bytes" << std::endl;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector<CatalogProblem> problems = validateCatalog(catalog);
+            printValidationReport(catalog, problems,
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
             break;
         }
         case 2:
-            if (!courses.empty()) {
-                printAlphanumericCourseList(courses);
+            if (!catalog.courses.empty()) {
+                printAlphanumericCourseList(catalog);
             }
             else {
                 std::cout << "No course data loaded yet." << std::endl;
             }
             break;
         case 3: {
-            if (!courses.empty()) {
+            if (!catalog.courses.empty()) {
                 std::string courseNumber;
                 std::cout << "Enter the course number to print information: ";
                 std::cin >> courseNumber;
-                printCourseInformation(courses, courseNumber);
+                printCourseInformation(catalog, courseNumber);
+            }
+            else {
+                std::cout << "No course data loaded yet." << std::endl;
+            }
+            break;
+        }
+        case 4: {
+            if (!catalog.courses.empty()) {
+                std::string courseNumber;
+                std::cout << "Enter the course number: ";
+                std::cin >> courseNumber;
+                printAllPrerequisites(catalog, courseNumber);
+            }
+            else {
+                std::cout << "No course data loaded yet." << std::endl;
+            }
+            break;
+        }
+        case 5: {
+            if (!catalog.courses.empty()) {
+                std::string courseNumber;
+                std::string completedList;
+                std::cout << "Enter the course number: ";
+                std::cin >> courseNumber;
+                std::cout << "Enter the completed courses separated by commas: ";
+                std::cin >> completedList;
+                printEligibility(catalog, courseNumber, completedList);
+            }
+            else {
+                std::cout << "No course data loaded yet." << std::endl;
+            }
+            break;
+        }
+        case 6: {
+            if (!catalog.courses.empty()) {
+                std::string prefix;
+                std::cout << "Enter the course number prefix (for example CSCI3): ";
+                std::cin >> prefix;
+                printCoursesWithPrefix(catalog, prefix);
             }
             else {
                 std::cout << "No course data loaded yet." << std::endl;
             }
             break;
         }
-        case 4:
+        case 7:
             std::cout << "Exiting the program." << std::endl;
             return 0;
         default:
-            std::cout << "Invalid choice. Please enter a number between 1 and 4." << std::endl;
+            std::cout << "Invalid choice. Please enter a number between 1 and 7." << std::endl;
         }
     }
 }
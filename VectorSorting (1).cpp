@@ -5,31 +5,33 @@
 // Description : Vector Sorting Algorithms
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iterator>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <time.h>
-#include "CSVparser.hpp"
+#include "BidExport.hpp"
+#include "BidIndex.hpp"
+#include "BidSnapshot.hpp"
+#include "BidStore.hpp"
+#include "BidTrace.hpp"
+#include "MappedCsv.hpp"
 
 using namespace std;
 
 // Global definitions
 double strToDouble(string str, char ch);
 
-// Bid structure
-struct Bid {
-    string bidId;
-    string title;
-    string fund;
-    double amount;
-    Bid() {
-        amount = 0.0;
-    }
-};
-
-// Display bid info
-void displayBid(Bid bid) {
-    cout << bid.bidId << ": " << bid.title << " | " << bid.amount << " | " << bid.fund << endl;
-}
-
 // Prompt user for a bid
 Bid getBid() {
     Bid bid;
@@ -48,36 +50,14 @@ Bid getBid() {
     return bid;
 }
 
-// Load bids from CSV
-vector<Bid> loadBids(string csvPath) {
-    cout << "Loading CSV file " << csvPath << endl;
-    vector<Bid> bids;
-
-    try {
-        csv::Parser file = csv::Parser(csvPath);
-        for (int i = 0; i < file.rowCount(); i++) {
-            Bid bid;
-            bid.bidId = file[i][1];
-            bid.title = file[i][0];
-            bid.fund = file[i][8];
-            bid.amount = strToDouble(file[i][4], '$');
-            bids.push_back(bid);
-        }
-    }
-    catch (csv::Error& e) {
-        cerr << e.what() << endl;
-    }
-    return bids;
-}
-
-// Selection sort
-void selectionSort(vector<Bid>& bids) {
+// Selection sort; rows are ordered by title, only the ids move
+void selectionSort(const BidStore* store, vector<RowId>& bids) {
     size_t size = bids.size();
 
     for (size_t pos = 0; pos < size - 1; ++pos) {
         size_t min = pos;
         for (size_t j = pos + 1; j < size; ++j) {
-            if (bids[j].title < bids[min].title) {
+            if (store->Title(bids[j]) < store->Title(bids[min])) {
                 min = j;
             }
         }
@@ -87,38 +67,856 @@ void selectionSort(vector<Bid>& bids) {
     }
 }
 
-// Quick sort partition
-int partition(vector<Bid>& bids, int begin, int end) {
+// Quick sort partition. Returns the last index of the low half, which
+// always lies in [begin, end - 1] so both halves shrink.
+int partition(const BidStore* store, vector<RowId>& bids, int begin, int end) {
     int low = begin;
     int high = end;
-    string pivot = bids[(begin + end) / 2].title;
+    string_view pivot = store->Title(bids[begin + (end - begin) / 2]);
 
-    while (low <= high) {
-        while (bids[low].title < pivot) {
+    while (true) {
+        while (store->Title(bids[low]) < pivot) {
             ++low;
         }
-        while (bids[high].title > pivot) {
+        while (store->Title(bids[high]) > pivot) {
             --high;
         }
-        if (low <= high) {
-            swap(bids[low], bids[high]);
-            ++low;
-            --high;
+        if (low >= high) {
+            return high;
         }
+        swap(bids[low], bids[high]);
+        ++low;
+        --high;
     }
-    return high;
 }
 
 // Quick sort
-void quickSort(vector<Bid>& bids, int begin, int end) {
+void quickSort(const BidStore* store, vector<RowId>& bids, int begin, int end) {
     if (begin >= end) {
         return;
     }
-    int mid = partition(bids, begin, end);
-    quickSort(bids, begin, mid);
-    quickSort(bids, mid + 1, end);
+    int mid = partition(store, bids, begin, end);
+    quickSort(store, bids, begin, mid);
+    quickSort(store, bids, mid + 1, end);
+}
+
+// Fixed set of threads, each with its own task deque. A thread runs its
+// newest task first and, once its deque is empty, steals the oldest task
+// from another thread, so large partitions spread out early while small
+// ones stay on the thread that made them. The thread calling Wait() takes
+// slot 0 and works too, so a pool of one thread starts no workers.
+class WorkStealingPool {
+
+public:
+    typedef function<void()> Task;
+
+    explicit WorkStealingPool(unsigned threads);
+    ~WorkStealingPool();
+    void Submit(Task task);
+    void Wait();
+
+private:
+    struct Queue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+    atomic<size_t> pending{ 0 }; // submitted but not yet finished
+    atomic<size_t> queued{ 0 };  // sitting in a deque
+    atomic<bool> stopping{ false };
+    mutex sleepLock;
+    condition_variable wake;
+
+    static thread_local WorkStealingPool* currentPool;
+    static thread_local unsigned currentSlot;
+
+    bool runOne(unsigned slot);
+    void workerLoop(unsigned slot);
+};
+
+thread_local WorkStealingPool* WorkStealingPool::currentPool = nullptr;
+thread_local unsigned WorkStealingPool::currentSlot = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    threads = max(1u, threads);
+    for (unsigned i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Pushes onto the calling pool thread's own deque, or slot 0 otherwise
+void WorkStealingPool::Submit(Task task) {
+    unsigned slot = currentPool == this ? currentSlot : 0;
+    pending++;
+    {
+        lock_guard<mutex> lock(queues[slot]->lock);
+        queues[slot]->tasks.push_back(std::move(task));
+    }
+    queued++;
+    {
+        lock_guard<mutex> lock(sleepLock);
+    }
+    wake.notify_one();
+}
+
+// Runs tasks on the calling thread until every submitted task is done
+void WorkStealingPool::Wait() {
+    WorkStealingPool* outerPool = currentPool;
+    unsigned outerSlot = currentSlot;
+    currentPool = this;
+    currentSlot = 0;
+    while (pending > 0) {
+        if (!runOne(0)) {
+            this_thread::yield();
+        }
+    }
+    currentPool = outerPool;
+    currentSlot = outerSlot;
+}
+
+bool WorkStealingPool::runOne(unsigned slot) {
+    Task task;
+    {
+        lock_guard<mutex> lock(queues[slot]->lock);
+        if (!queues[slot]->tasks.empty()) {
+            task = std::move(queues[slot]->tasks.back());
+            queues[slot]->tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues.size(); i++) {
+        Queue& victim = *queues[(slot + i) % queues.size()];
+        lock_guard<mutex> lock(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued--;
+    task();
+    pending--;
+    return true;
+}
+
+void WorkStealingPool::workerLoop(unsigned slot) {
+    currentPool = this;
+    currentSlot = slot;
+    while (true) {
+        if (runOne(slot)) {
+            continue;
+        }
+        unique_lock<mutex> lock(sleepLock);
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+// Ranges at or below this size are finished with insertion sort
+const ptrdiff_t INSERTION_CUTOFF = 16;
+// Partitions at least this large are handed to the pool as their own task
+const ptrdiff_t PARALLEL_GRAIN = 1 << 14;
+
+struct TitleLess {
+    const BidStore* store;
+
+    bool operator()(RowId a, RowId b) const {
+        return store->Title(a) < store->Title(b);
+    }
+};
+
+void insertionSort(const BidStore* store, RowId* first, RowId* last) {
+    for (RowId* i = first + 1; i < last; ++i) {
+        RowId row = *i;
+        string_view title = store->Title(row);
+        RowId* j = i;
+        while (j > first && title < store->Title(*(j - 1))) {
+            *j = *(j - 1);
+            --j;
+        }
+        *j = row;
+    }
+}
+
+// Hoare partition around the median of the first, middle and last titles.
+// The median is left in the middle slot, which guarantees the returned
+// cut is strictly inside (first, last).
+RowId* partitionByTitle(const BidStore* store, RowId* first, RowId* last) {
+    TitleLess less{ store };
+    RowId* mid = first + (last - first - 1) / 2;
+    if (less(*mid, *first)) {
+        swap(*mid, *first);
+    }
+    if (less(*(last - 1), *mid)) {
+        swap(*(last - 1), *mid);
+        if (less(*mid, *first)) {
+            swap(*mid, *first);
+        }
+    }
+
+    string_view pivot = store->Title(*mid);
+    RowId* low = first;
+    RowId* high = last - 1;
+    while (true) {
+        while (store->Title(*low) < pivot) {
+            ++low;
+        }
+        while (pivot < store->Title(*high)) {
+            --high;
+        }
+        if (low >= high) {
+            return high + 1;
+        }
+        swap(*low, *high);
+        ++low;
+        --high;
+    }
+}
+
+// Introsort: quick sort that falls back to heap sort once it has gone
+// depthLimit levels deep, so the worst case stays O(n log n). The smaller
+// side of each split is sorted first (or given to the pool when it is big
+// enough) and the loop continues on the larger side.
+void introSort(WorkStealingPool& pool, const BidStore* store, RowId* first, RowId* last, int depthLimit) {
+    while (last - first > INSERTION_CUTOFF) {
+        if (depthLimit == 0) {
+            make_heap(first, last, TitleLess{ store });
+            sort_heap(first, last, TitleLess{ store });
+            return;
+        }
+        depthLimit--;
+
+        RowId* cut = partitionByTitle(store, first, last);
+        RowId* smallFirst = first;
+        RowId* smallLast = cut;
+        if (cut - first > last - cut) {
+            smallFirst = cut;
+            smallLast = last;
+            last = cut;
+        }
+        else {
+            first = cut;
+        }
+
+        if (smallLast - smallFirst >= PARALLEL_GRAIN) {
+            pool.Submit([&pool, store, smallFirst, smallLast, depthLimit]() {
+                introSort(pool, store, smallFirst, smallLast, depthLimit);
+            });
+        }
+        else {
+            introSort(pool, store, smallFirst, smallLast, depthLimit);
+        }
+    }
+    insertionSort(store, first, last);
+}
+
+// Parallel sort by title on a work-stealing pool of the given size
+void parallelSort(const BidStore* store, vector<RowId>& bids, unsigned threads) {
+    if (bids.size() < 2) {
+        return;
+    }
+
+    int depthLimit = 0;
+    for (size_t n = bids.size(); n > 1; n >>= 1) {
+        depthLimit += 2;
+    }
+
+    WorkStealingPool pool(threads);
+    RowId* first = bids.data();
+    RowId* last = first + bids.size();
+    pool.Submit([&pool, store, first, last, depthLimit]() {
+        introSort(pool, store, first, last, depthLimit);
+    });
+    pool.Wait();
+}
+
+// A row paired with the first bytes of its title, packed big-endian so
+// comparing the integers orders them like the strings. Short titles are
+// padded with zero bytes, which sort ahead of any character.
+struct PrefixKey {
+    uint64_t prefix;
+    RowId row;
+};
+
+const size_t PREFIX_BYTES = sizeof(uint64_t);
+
+uint64_t titlePrefix(string_view title) {
+    uint64_t prefix = 0;
+    size_t length = min(title.size(), PREFIX_BYTES);
+    for (size_t i = 0; i < PREFIX_BYTES; i++) {
+        prefix <<= 8;
+        if (i < length) {
+            prefix |= (unsigned char)title[i];
+        }
+    }
+    return prefix;
+}
+
+// Stable sort by title that never compares strings unless two titles
+// share their first eight bytes. The 16-byte (prefix, row) pairs are LSD
+// radix sorted one byte per pass, skipping bytes every key has in
+// common, then each run of equal prefixes is ordered by the rest of the
+// title. The rows are written back in their final order once.
+void prefixRadixSort(const BidStore* store, vector<RowId>& bids) {
+    size_t size = bids.size();
+    if (size < 2) {
+        return;
+    }
+
+    vector<PrefixKey> keys(size);
+    vector<PrefixKey> scratch(size);
+    for (size_t i = 0; i < size; i++) {
+        keys[i].prefix = titlePrefix(store->Title(bids[i]));
+        keys[i].row = bids[i];
+    }
+
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {};
+        for (const PrefixKey& key : keys) {
+            counts[(key.prefix >> shift) & 0xFF]++;
+        }
+        if (counts[(keys[0].prefix >> shift) & 0xFF] == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+        for (const PrefixKey& key : keys) {
+            scratch[counts[(key.prefix >> shift) & 0xFF]++] = key;
+        }
+        keys.swap(scratch);
+    }
+
+    // Prefix ties fall back to comparing the remainder of the titles
+    size_t runStart = 0;
+    for (size_t i = 1; i <= size; i++) {
+        if (i < size && keys[i].prefix == keys[runStart].prefix) {
+            continue;
+        }
+        if (i - runStart > 1) {
+            stable_sort(keys.begin() + runStart, keys.begin() + i, [store](const PrefixKey& a, const PrefixKey& b) {
+                string_view left = store->Title(a.row);
+                string_view right = store->Title(b.row);
+                return left.substr(min(left.size(), PREFIX_BYTES)) < right.substr(min(right.size(), PREFIX_BYTES));
+            });
+        }
+        runStart = i;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        bids[i] = keys[i].row;
+    }
+}
+
+// Size of every buffered read and write the external sort makes
+const size_t IO_BUFFER_BYTES = 1 << 20;
+// Most runs merged at once; more runs than this take extra merge passes
+const size_t MAX_MERGE_FANIN = 64;
+
+struct ExternalSortStats {
+    size_t rows = 0;
+    size_t runs = 0;
+    size_t mergePasses = 0;
+};
+
+// Collects small writes into one large buffer and hands the file whole
+// blocks at a time
+class BufferedWriter {
+
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t used = 0;
+    bool failed = false;
+
+public:
+    BufferedWriter(FILE* out, size_t bytes) : file(out), buffer(bytes) {
+    }
+
+    void Write(const void* data, size_t length) {
+        if (used + length > buffer.size()) {
+            Flush();
+        }
+        if (length >= buffer.size()) {
+            failed |= fwrite(data, 1, length, file) != length;
+            return;
+        }
+        memcpy(buffer.data() + used, data, length);
+        used += length;
+    }
+
+    // One run record: title length, line length, then both strings
+    void WriteRecord(string_view title, string_view line) {
+        uint32_t lengths[2] = { (uint32_t)title.size(), (uint32_t)line.size() };
+        Write(lengths, sizeof(lengths));
+        Write(title.data(), title.size());
+        Write(line.data(), line.size());
+    }
+
+    bool Flush() {
+        if (used > 0) {
+            failed |= fwrite(buffer.data(), 1, used, file) != used;
+            used = 0;
+        }
+        return !failed && fflush(file) == 0;
+    }
+};
+
+// Reads run records back through a buffer of its own
+class RunReader {
+
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t pos = 0;
+    size_t filled = 0;
+
+    bool read(char* out, size_t length) {
+        while (length > 0) {
+            if (pos == filled) {
+                filled = fread(buffer.data(), 1, buffer.size(), file);
+                pos = 0;
+                if (filled == 0) {
+                    return false;
+                }
+            }
+            size_t chunk = min(length, filled - pos);
+            memcpy(out, buffer.data() + pos, chunk);
+            pos += chunk;
+            out += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+
+public:
+    string title;
+    string line;
+    bool done = false;
+
+    RunReader(FILE* in, size_t bytes) : file(in), buffer(bytes) {
+        rewind(file);
+    }
+
+    // Loads the next record, or marks the run done
+    void Next() {
+        uint32_t lengths[2];
+        if (!read(reinterpret_cast<char*>(lengths), sizeof(lengths))) {
+            done = true;
+            return;
+        }
+        title.resize(lengths[0]);
+        line.resize(lengths[1]);
+        done = !read(&title[0], title.size()) || !read(&line[0], line.size());
+    }
+};
+
+// Tournament tree over k runs. Each inner node keeps the loser of the
+// match played there and slot 0 keeps the overall winner, so replacing
+// the winner replays only the log2(k) matches on its path to the root.
+// Equal titles go to the lower run, which keeps the merge stable.
+class LoserTree {
+
+private:
+    vector<RunReader>& runs;
+    vector<int> tree;
+    int k;
+
+    // Leaf k is a sentinel that beats everything, used only while building
+    bool beats(int a, int b) const {
+        if (a == k || b == k) {
+            return a == k;
+        }
+        if (runs[a].done || runs[b].done) {
+            return !runs[a].done;
+        }
+        int order = runs[a].title.compare(runs[b].title);
+        return order != 0 ? order < 0 : a < b;
+    }
+
+public:
+    LoserTree(vector<RunReader>& inputs) : runs(inputs) {
+        k = (int)runs.size();
+        tree.assign(max(k, 1), k);
+        for (int i = k - 1; i >= 0; i--) {
+            Replay(i);
+        }
+    }
+
+    // Run holding the smallest title, or -1 once every run is done
+    int Winner() const {
+        return k == 0 || runs[tree[0]].done ? -1 : tree[0];
+    }
+
+    // Call after leaf has advanced to its next record
+    void Replay(int leaf) {
+        for (int node = (leaf + k) / 2; node > 0; node /= 2) {
+            if (beats(tree[node], leaf)) {
+                swap(tree[node], leaf);
+            }
+        }
+        tree[0] = leaf;
+    }
+};
+
+// k-way merge of sorted runs into out, either as another run or as the
+// final CSV lines
+bool mergeRuns(const vector<FILE*>& inputs, BufferedWriter& out, bool asRun, size_t bufferBytes) {
+    vector<RunReader> runs;
+    runs.reserve(inputs.size());
+    for (FILE* input : inputs) {
+        runs.emplace_back(input, bufferBytes);
+        runs.back().Next();
+    }
+
+    LoserTree tree(runs);
+    for (int winner = tree.Winner(); winner >= 0; winner = tree.Winner()) {
+        RunReader& run = runs[winner];
+        if (asRun) {
+            out.WriteRecord(run.title, run.line);
+        }
+        else {
+            out.Write(run.line.data(), run.line.size());
+        }
+        run.Next();
+        tree.Replay(winner);
+    }
+    return out.Flush();
+}
+
+// A row of the chunk being sorted: its title then its raw CSV line,
+// stored back to back in the chunk's arena
+struct ChunkRecord {
+    size_t offset;
+    uint32_t titleLength;
+    uint32_t lineLength;
+};
+
+// Sorts the chunk by title and writes it to a new anonymous temp file
+bool spillRun(vector<char>& arena, vector<ChunkRecord>& records, vector<FILE*>& runs) {
+    const char* base = arena.data();
+    stable_sort(records.begin(), records.end(), [base](const ChunkRecord& a, const ChunkRecord& b) {
+        return string_view(base + a.offset, a.titleLength) < string_view(base + b.offset, b.titleLength);
+    });
+
+    FILE* run = tmpfile();
+    if (run == nullptr) {
+        cerr << "Unable to create a temporary run file" << endl;
+        return false;
+    }
+    setvbuf(run, nullptr, _IONBF, 0);
+    runs.push_back(run);
+
+    BufferedWriter writer(run, IO_BUFFER_BYTES);
+    for (const ChunkRecord& record : records) {
+        const char* title = base + record.offset;
+        writer.WriteRecord(string_view(title, record.titleLength), string_view(title + record.titleLength, record.lineLength));
+    }
+    arena.clear();
+    records.clear();
+    return writer.Flush();
+}
+
+// Sorts the rows of a CSV file by title into outPath without holding the
+// file in memory. The rows are read in chunks that fit in memoryBudget
+// bytes; each chunk is sorted and spilled to a temporary run file, then
+// the runs are merged through a loser tree, MAX_MERGE_FANIN at a time.
+// Rows keep their original text; rows with equal titles keep file order.
+bool externalSort(const string& csvPath, const string& outPath, size_t memoryBudget, ExternalSortStats* stats) {
+    MappedFile file;
+    if (!file.Open(csvPath)) {
+        cerr << "Unable to open " << csvPath << endl;
+        return false;
+    }
+    FILE* out = fopen(outPath.c_str(), "wb");
+    if (out == nullptr) {
+        cerr << "Unable to create " << outPath << endl;
+        return false;
+    }
+    setvbuf(out, nullptr, _IONBF, 0);
+
+    // Three quarters of the budget holds row text, the rest the records
+    size_t arenaBytes = memoryBudget / 4 * 3;
+    size_t maxRecords = max<size_t>(1, memoryBudget / 4 / sizeof(ChunkRecord));
+    vector<char> arena;
+    vector<ChunkRecord> records;
+    arena.reserve(arenaBytes);
+    records.reserve(maxRecords);
+
+    vector<FILE*> runs;
+    bool ok = true;
+    BufferedWriter writer(out, IO_BUFFER_BYTES);
+    CsvReader reader(file.begin(), file.end());
+    CsvRow row;
+
+    // The header goes out first, unsorted
+    const char* lineStart = reader.Position();
+    if (reader.NextRow(row)) {
+        writer.Write(lineStart, (size_t)(reader.Position() - lineStart));
+        if (reader.Position() == lineStart || reader.Position()[-1] != '\n') {
+            writer.Write("\n", 1);
+        }
+    }
+
+    lineStart = reader.Position();
+    while (ok && reader.NextRow(row)) {
+        string_view line(lineStart, (size_t)(reader.Position() - lineStart));
+        lineStart = reader.Position();
+        if (row.size() <= 8) {
+            continue;
+        }
+        string title = csvFieldToString(row[0]);
+        bool addNewline = line.back() != '\n';
+        size_t length = title.size() + line.size() + (addNewline ? 1 : 0);
+
+        if (!records.empty() && (arena.size() + length > arenaBytes || records.size() == maxRecords)) {
+            ok = spillRun(arena, records, runs);
+        }
+        ChunkRecord record = { arena.size(), (uint32_t)title.size(), (uint32_t)(length - title.size()) };
+        arena.insert(arena.end(), title.begin(), title.end());
+        arena.insert(arena.end(), line.begin(), line.end());
+        if (addNewline) {
+            arena.push_back('\n');
+        }
+        records.push_back(record);
+        stats->rows++;
+    }
+    if (ok && !records.empty()) {
+        ok = spillRun(arena, records, runs);
+    }
+    vector<char>().swap(arena);
+    vector<ChunkRecord>().swap(records);
+    stats->runs = runs.size();
+
+    // Merge consecutive groups of runs, keeping them in file order, until
+    // one merge can finish the job
+    while (ok && runs.size() > MAX_MERGE_FANIN) {
+        vector<FILE*> merged;
+        for (size_t i = 0; i < runs.size(); i += MAX_MERGE_FANIN) {
+            vector<FILE*> group(runs.begin() + i, runs.begin() + min(runs.size(), i + MAX_MERGE_FANIN));
+            FILE* run = ok ? tmpfile() : nullptr;
+            if (ok && run == nullptr) {
+                cerr << "Unable to create a temporary run file" << endl;
+                ok = false;
+            }
+            if (ok) {
+                setvbuf(run, nullptr, _IONBF, 0);
+                merged.push_back(run);
+                BufferedWriter runWriter(run, IO_BUFFER_BYTES);
+                ok = mergeRuns(group, runWriter, true, max<size_t>(1 << 16, memoryBudget / (group.size() + 1)));
+            }
+            for (FILE* input : group) {
+                fclose(input);
+            }
+        }
+        runs.swap(merged);
+        stats->mergePasses++;
+    }
+
+    if (ok) {
+        ok = mergeRuns(runs, writer, false, max<size_t>(1 << 16, memoryBudget / (runs.size() + 1)));
+        stats->mergePasses++;
+    }
+    for (FILE* run : runs) {
+        fclose(run);
+    }
+    ok = writer.Flush() && ok;
+    return fclose(out) == 0 && ok;
+}
+
+// Orders by amount, largest first. A NaN amount (the loaders keep one for
+// an unparseable field) sorts after every number, so the views and top-K
+// still get a strict weak ordering.
+struct AmountGreater {
+    const BidStore* store;
+
+    bool operator()(RowId a, RowId b) const {
+        double left = store->Amount(a);
+        double right = store->Amount(b);
+        if (isnan(left)) {
+            return false;
+        }
+        if (isnan(right)) {
+            return true;
+        }
+        return left > right;
+    }
+};
+
+// Breaks ties in Less by row id, so equal keys always come out in load
+// order and top-K and the sorted views agree on the same answer
+template <typename Less>
+struct ThenByRow {
+    Less less;
+
+    bool operator()(RowId a, RowId b) const {
+        if (less(a, b)) {
+            return true;
+        }
+        if (less(b, a)) {
+            return false;
+        }
+        return a < b;
+    }
+};
+
+// The first k rows in Less order, best first, in O(n log k). A bounded
+// heap holds the k best rows seen so far with the worst of them on top,
+// so each new row is either rejected by one compare or swapped in.
+template <typename Less>
+vector<RowId> topK(const vector<RowId>& bids, size_t k, Less less) {
+    ThenByRow<Less> order{ less };
+    vector<RowId> heap;
+    if (k == 0) {
+        return heap;
+    }
+    heap.reserve(min(k, bids.size()));
+
+    for (RowId row : bids) {
+        if (heap.size() < k) {
+            heap.push_back(row);
+            push_heap(heap.begin(), heap.end(), order);
+        }
+        else if (order(row, heap.front())) {
+            pop_heap(heap.begin(), heap.end(), order);
+            heap.back() = row;
+            push_heap(heap.begin(), heap.end(), order);
+        }
+    }
+    sort_heap(heap.begin(), heap.end(), order);
+    return heap;
+}
+
+// Rows kept in Less order while bids are added and removed. Each update
+// costs O(log n) and reading the first n rows O(n), instead of sorting
+// the whole vector again for every query.
+template <typename Less>
+class SortedBidView {
+
+private:
+    set<RowId, ThenByRow<Less>> rows;
+
+public:
+    explicit SortedBidView(Less less) : rows(ThenByRow<Less>{ less }) {
+    }
+
+    // Replaces the contents; sorting first lets every insert append
+    void Assign(vector<RowId> bids) {
+        sort(bids.begin(), bids.end(), rows.key_comp());
+        rows.clear();
+        for (RowId row : bids) {
+            rows.insert(rows.end(), row);
+        }
+    }
+
+    void Add(RowId row) {
+        rows.insert(row);
+    }
+
+    // The row must still be in the store, since its key is read back
+    void Remove(RowId row) {
+        rows.erase(row);
+    }
+
+    vector<RowId> First(size_t n) const {
+        vector<RowId> first;
+        first.reserve(min(n, rows.size()));
+        for (typename set<RowId, ThenByRow<Less>>::const_iterator it = rows.begin(); it != rows.end() && first.size() < n; ++it) {
+            first.push_back(*it);
+        }
+        return first;
+    }
+
+    size_t Size() const {
+        return rows.size();
+    }
+};
+
+// Shows the first k rows of a view, then times the same query answered
+// by a bounded heap over every bid
+template <typename Less>
+void showTopK(const BidStore* store, const vector<RowId>& bids, const SortedBidView<Less>& view, size_t k, Less less) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<RowId> first = view.First(k);
+    double viewSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    vector<RowId> selected = topK(bids, k, less);
+    double heapSeconds = secondsSince(start);
+
+    for (RowId row : first) {
+        displayBid(BidRef(store, row));
+    }
+    cout << "sorted view: " << viewSeconds << " seconds" << endl;
+    cout << "bounded heap: " << heapSeconds << " seconds" << (selected == first ? "" : " (results differ)") << endl;
 }
 
+// A bid vector behind the Insert / Search / Remove calls replayTrace
+// makes. Inserts append; searches and removes scan the vector, as the
+// menu's Remove Bid does.
+class BidVector {
+
+private:
+    BidStore* store;
+    vector<RowId> bids;
+
+    vector<RowId>::iterator find(const string& bidId) {
+        return find_if(bids.begin(), bids.end(), [this, &bidId](RowId row) {
+            return store->BidId(row) == bidId;
+        });
+    }
+
+public:
+    explicit BidVector(BidStore* bidStore) : store(bidStore) {
+    }
+
+    void Insert(const Bid& bid) {
+        bids.push_back(store->Append(bid));
+    }
+
+    BidRef Search(const string& bidId) {
+        vector<RowId>::iterator found = find(bidId);
+        return found == bids.end() ? BidRef() : BidRef(store, *found);
+    }
+
+    void Remove(const string& bidId) {
+        vector<RowId>::iterator found = find(bidId);
+        if (found != bids.end()) {
+            bids.erase(found);
+        }
+    }
+
+    void PrintAll() {
+        BidExporter out(cout);
+        for (RowId row : bids) {
+            out.Write(BidRef(store, row));
+        }
+    }
+};
+
 // Convert string to double
 double strToDouble(string str, char ch) {
     str.erase(remove(str.begin(), str.end(), ch), str.end());
@@ -136,52 +934,258 @@ int main(int argc, char* argv[]) {
         csvPath = "eBid_Monthly_Sales.csv";
     }
 
-    vector<Bid> bids;
+    BidStore store;
+    vector<RowId> bids;
+    SortedBidView<AmountGreater> byAmount(AmountGreater{ &store });
+    SortedBidView<TitleLess> byTitle(TitleLess{ &store });
+    BidSecondaryIndex secondary(&store); // fund and amount lookups over bids
+    LoadTimings timings;
     clock_t ticks;
+    chrono::steady_clock::time_point wallStart;
     int choice = 0;
 
+    // Set BID_TRACE to record loads, displays, adds and removes for replay
+    // here or against the hash table and tree programs
+    TraceWriter trace;
+    openTraceFromEnvironment(trace);
+
     while (choice != 9) {
         cout << "Menu:" << endl;
         cout << " 1. Load Bids" << endl;
         cout << " 2. Display All Bids" << endl;
         cout << " 3. Selection Sort All Bids" << endl;
         cout << " 4. Quick Sort All Bids" << endl;
+        cout << " 5. Parallel Sort All Bids" << endl;
+        cout << " 6. Prefix Radix Sort All Bids" << endl;
+        cout << " 7. External Sort Bids File" << endl;
+        cout << " 8. Top K Bids" << endl;
         cout << " 9. Exit" << endl;
+        cout << "10. Add Bid" << endl;
+        cout << "11. Remove Bid" << endl;
+        cout << "12. Export Bids" << endl;
+        cout << "13. Save Snapshot" << endl;
+        cout << "14. Load Snapshot" << endl;
+        cout << "15. Find Bids by Fund" << endl;
+        cout << "16. Find Bids by Amount" << endl;
+        cout << "17. Search Snapshot" << endl;
+        cout << "18. Replay Trace" << endl;
         cout << "Enter choice: ";
         cin >> choice;
 
         switch (choice) {
         case 1:
             ticks = clock();
-            bids = loadBids(csvPath);
-            cout << bids.size() << " bids read" << endl;
+            bids.clear();
+            secondary.Clear();
+            store.Clear();
+            bids = loadBidCsv(csvPath, &store, timings);
+            byAmount.Assign(bids);
+            byTitle.Assign(bids);
+            secondary.AddRows(bids);
+            printLoadTimings(timings);
             ticks = clock() - ticks;
+            for (size_t i = 0; trace.IsOpen() && i < bids.size(); ++i) {
+                trace.Insert(BidRef(&store, bids[i]));
+            }
             cout << "time: " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
             break;
 
-        case 2:
+        case 2: {
+            trace.Print();
+            BidExporter out(cout);
             for (size_t i = 0; i < bids.size(); ++i) {
-                displayBid(bids[i]);
+                out.Write(BidRef(&store, bids[i]));
             }
+            out.Close();
             cout << endl;
             break;
+        }
 
+        // clock() adds up CPU time across threads, so every sort also
+        // reports wall time to keep the options comparable
         case 3:
             ticks = clock();
-            selectionSort(bids);
+            wallStart = chrono::steady_clock::now();
+            if (!bids.empty()) {
+                selectionSort(&store, bids);
+            }
             ticks = clock() - ticks;
             cout << "Selection sort completed in " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            cout << "wall: " << secondsSince(wallStart) << " seconds" << endl;
             break;
 
         case 4:
             ticks = clock();
-            quickSort(bids, 0, bids.size() - 1);
+            wallStart = chrono::steady_clock::now();
+            if (!bids.empty()) {
+                quickSort(&store, bids, 0, (int)bids.size() - 1);
+            }
             ticks = clock() - ticks;
             cout << "Quick sort completed in " << ticks << " clock ticks" << endl;
             cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            cout << "wall: " << secondsSince(wallStart) << " seconds" << endl;
+            break;
+
+        case 5:
+            ticks = clock();
+            wallStart = chrono::steady_clock::now();
+            parallelSort(&store, bids, loaderThreads());
+            ticks = clock() - ticks;
+            cout << "Parallel sort completed on " << loaderThreads() << " thread(s) in " << ticks << " clock ticks" << endl;
+            cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            cout << "wall: " << secondsSince(wallStart) << " seconds" << endl;
+            break;
+
+        case 6:
+            ticks = clock();
+            wallStart = chrono::steady_clock::now();
+            prefixRadixSort(&store, bids);
+            ticks = clock() - ticks;
+            cout << "Prefix radix sort completed in " << ticks << " clock ticks" << endl;
+            cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            cout << "wall: " << secondsSince(wallStart) << " seconds" << endl;
             break;
+
+        // Sorts the CSV file itself, file to file, without loading it
+        case 7: {
+            size_t budgetMb = 0;
+            cout << "Enter memory budget in MB: ";
+            cin >> budgetMb;
+            string outPath = csvPath;
+            if (outPath.size() > 4 && outPath.compare(outPath.size() - 4, 4, ".csv") == 0) {
+                outPath.erase(outPath.size() - 4);
+            }
+            outPath += "_sorted.csv";
+
+            ExternalSortStats stats;
+            ticks = clock();
+            wallStart = chrono::steady_clock::now();
+            bool sorted = externalSort(csvPath, outPath, max<size_t>(1, budgetMb) << 20, &stats);
+            ticks = clock() - ticks;
+            if (sorted) {
+                cout << stats.rows << " bids sorted into " << outPath << " from " << stats.runs << " run(s) in " << stats.mergePasses << " merge pass(es)" << endl;
+            }
+            cout << "External sort completed in " << ticks << " clock ticks" << endl;
+            cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            cout << "wall: " << secondsSince(wallStart) << " seconds" << endl;
+            break;
+        }
+
+        case 8: {
+            size_t k = 0;
+            int order = 0;
+            cout << "Enter K: ";
+            cin >> k;
+            cout << "Order by (1) largest amount or (2) title: ";
+            cin >> order;
+            if (order == 1) {
+                showTopK(&store, bids, byAmount, k, AmountGreater{ &store });
+            }
+            else {
+                showTopK(&store, bids, byTitle, k, TitleLess{ &store });
+            }
+            break;
+        }
+
+        // The sorted views and secondary index follow every add and remove
+        case 10: {
+            Bid bid = getBid();
+            RowId row = store.Append(bid);
+            trace.Insert(BidRef(&store, row));
+            bids.push_back(row);
+            byAmount.Add(row);
+            byTitle.Add(row);
+            secondary.Add(row);
+            displayBid(BidRef(&store, row));
+            break;
+        }
+
+        case 11: {
+            string bidKey;
+            cout << "Enter Id: ";
+            cin >> bidKey;
+            trace.Remove(bidKey);
+            vector<RowId>::iterator found = find_if(bids.begin(), bids.end(), [&store, &bidKey](RowId row) {
+                return store.BidId(row) == bidKey;
+            });
+            if (found == bids.end()) {
+                cout << "Bid Id " << bidKey << " not found." << endl;
+                break;
+            }
+            byAmount.Remove(*found);
+            byTitle.Remove(*found);
+            secondary.Remove(*found);
+            bids.erase(found);
+            break;
+        }
+
+        // Exports in the vector's current order, sorted or not
+        case 12:
+            exportFromMenu([&](auto write) {
+                for (RowId row : bids) {
+                    write(BidRef(&store, row));
+                }
+            });
+            break;
+
+        // Saves the vector in its current order, sorted or not
+        case 13:
+            ticks = clock();
+            if (saveSnapshot(promptSnapshotPath(), "vector", store, bids)) {
+                ticks = clock() - ticks;
+                cout << bids.size() << " bids saved" << endl;
+                cout << "time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+            }
+            break;
+
+        // Replaces the loaded bids, as Load Bids does, in the saved order
+        // The loaded bids are only dropped once the snapshot checks out
+        case 14:
+            loadSnapshot(promptSnapshotPath(), store, [&]() {
+                bids.clear();
+                byAmount.Assign(bids);
+                byTitle.Assign(bids);
+                secondary.Clear();
+                store.Clear();
+            }, [&](vector<RowId>& rows, vector<RowId>&) {
+                bids.swap(rows);
+                byAmount.Assign(bids);
+                byTitle.Assign(bids);
+                secondary.AddRows(bids);
+            });
+            for (size_t i = 0; trace.IsOpen() && i < bids.size(); ++i) {
+                trace.Insert(BidRef(&store, bids[i]));
+            }
+            break;
+
+        case 15:
+            fundQueryFromMenu([&](const string& fund) { return secondary.Fund(fund); });
+            break;
+
+        case 16:
+            amountQueryFromMenu([&](double low, double high) { return secondary.Amount(low, high); });
+            break;
+
+        case 17:
+            searchSnapshotFromMenu();
+            break;
+
+        // Replays into an empty vector of its own, so the loaded bids and
+        // their sorted views are left as they are
+        case 18: {
+            string tracePath;
+            vector<TraceEvent> events;
+            cout << "Enter trace file: ";
+            cin >> tracePath;
+            if (readTrace(tracePath, events)) {
+                BidStore replayStore;
+                BidVector replayed(&replayStore);
+                printReplayStats(replayTrace(events, replayed, [](BidVector& bidVector) { bidVector.PrintAll(); }));
+            }
+            break;
+        }
         }
     }
 